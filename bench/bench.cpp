@@ -0,0 +1,409 @@
+// Micro-benchmarks for the tachyon primitives and the star shading kernel:
+//
+//   make bench && ./bench.out [FILTER] [--reps N] [--max-stars N]
+//
+// Every benchmark runs over a synthetic array, repeating passes until a sample takes at least
+// SAMPLE_MS, and takes N such samples. The median ns per operation is reported with its median
+// absolute deviation and the fastest sample, so a change can be judged against the noise rather
+// than a single run. FILTER keeps the benchmarks whose name contains it.
+
+#include "camera.hpp"
+#include "catalog.hpp"
+#include "render.hpp"
+#include "tachyon.hpp"
+#include "tachyon_frame.hpp"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+// Shortest time a sample runs for, so timer resolution and loop overhead are negligible.
+constexpr double SAMPLE_MS = 20.0;
+
+// Elements in the arrays the primitive benchmarks loop over; small enough to stay in cache.
+constexpr size_t PRIMITIVE_N = 4096;
+
+// Keeps a result alive without the compiler being able to see what happens to it.
+template <typename T>
+inline void
+keep (const T &value)
+{
+  asm volatile ("" : : "r"(&value) : "memory");
+}
+
+struct Result
+{
+  double median_ns, mad_ns, min_ns;
+};
+
+// `pass` does `ops` operations; returns the ns per operation over `reps` samples.
+Result
+measure (const std::function<void ()> &pass, size_t ops, int reps)
+{
+  using Clock = std::chrono::steady_clock;
+
+  // Warm up, then find how many passes make a sample long enough.
+  pass ();
+
+  size_t passes = 1;
+
+  while (true)
+    {
+      const auto start = Clock::now ();
+
+      for (size_t i = 0; i < passes; ++i)
+        pass ();
+
+      const double ms = std::chrono::duration<double, std::milli> (Clock::now () - start).count ();
+
+      if (ms >= SAMPLE_MS)
+        break;
+
+      passes *= ms > 0.0 ? std::clamp<size_t> (SAMPLE_MS / ms * 1.2, 2, 100) : 100;
+    }
+
+  std::vector<double> samples;
+
+  for (int r = 0; r < reps; ++r)
+    {
+      const auto start = Clock::now ();
+
+      for (size_t i = 0; i < passes; ++i)
+        pass ();
+
+      const double ns = std::chrono::duration<double, std::nano> (Clock::now () - start).count ();
+
+      samples.push_back (ns / (static_cast<double> (passes) * ops));
+    }
+
+  std::sort (samples.begin (), samples.end ());
+
+  const double median = samples[samples.size () / 2];
+
+  std::vector<double> deviations;
+
+  for (double s : samples)
+    deviations.push_back (std::abs (s - median));
+
+  std::sort (deviations.begin (), deviations.end ());
+
+  return { median, deviations[deviations.size () / 2], samples.front () };
+}
+
+struct Benchmark
+{
+  std::string name;
+  size_t n;
+
+  // Sets up its data and returns the pass to time, which does `n` operations.
+  std::function<std::function<void ()> ()> setup;
+};
+
+// Stars spread over a few kpc around the origin, with luminosities across the catalog's range.
+void
+synthetic_catalog (size_t n, std::vector<Body> &bodies, std::vector<uint8_t> &colors)
+{
+  std::mt19937_64 rng (n);
+  std::uniform_real_distribution<double> position (-2000.0, 2000.0);
+  std::uniform_real_distribution<double> log_luminosity (-4.0, 5.0);
+  std::uniform_int_distribution<int> color (0, 255);
+
+  bodies.resize (n);
+  colors.resize (n);
+
+  for (size_t i = 0; i < n; ++i)
+    {
+      bodies[i].position = t::vector3su (t::spatial_unit::from_pc (position (rng)),
+                                         t::spatial_unit::from_pc (position (rng)),
+                                         t::spatial_unit::from_pc (position (rng)));
+      bodies[i].luminosity = std::pow (10.0, log_luminosity (rng));
+      colors[i] = color (rng);
+    }
+}
+
+Camera
+bench_camera ()
+{
+  Camera camera{};
+
+  camera.y = 0.3;
+  camera.p = 0.1;
+  camera.focal_length = 8;
+  camera.f = 2.8;
+  camera.t = 2.0;
+  camera.iso = 1600;
+  camera.d = camera_distance (camera, WW);
+
+  return camera;
+}
+
+std::vector<Benchmark>
+benchmarks (size_t max_stars)
+{
+  std::vector<Benchmark> list;
+
+  list.push_back ({ "spatial_unit::from_pc", PRIMITIVE_N, [] {
+                     auto in = std::make_shared<std::vector<double>> (PRIMITIVE_N);
+                     auto out = std::make_shared<std::vector<t::spatial_unit>> (PRIMITIVE_N);
+
+                     for (size_t i = 0; i < PRIMITIVE_N; ++i)
+                       (*in)[i] = i * 0.37 - 700.0;
+
+                     return [in, out] {
+                       for (size_t i = 0; i < PRIMITIVE_N; ++i)
+                         (*out)[i] = t::spatial_unit::from_pc ((*in)[i]);
+
+                       keep (out->data ());
+                     };
+                   } });
+
+  list.push_back ({ "spatial_unit::as_AU", PRIMITIVE_N, [] {
+                     auto in = std::make_shared<std::vector<t::spatial_unit>> (PRIMITIVE_N);
+                     auto out = std::make_shared<std::vector<double>> (PRIMITIVE_N);
+
+                     for (size_t i = 0; i < PRIMITIVE_N; ++i)
+                       (*in)[i] = t::spatial_unit::from_pc (i * 0.37 - 700.0);
+
+                     return [in, out] {
+                       for (size_t i = 0; i < PRIMITIVE_N; ++i)
+                         (*out)[i] = (*in)[i].as_AU ();
+
+                       keep (out->data ());
+                     };
+                   } });
+
+  list.push_back ({ "vector3su a - b", PRIMITIVE_N, [] {
+                     auto a = std::make_shared<std::vector<t::vector3su>> (PRIMITIVE_N);
+                     auto out = std::make_shared<std::vector<t::vector3su>> (PRIMITIVE_N);
+
+                     for (size_t i = 0; i < PRIMITIVE_N; ++i)
+                       (*a)[i] = t::vector3su (t::spatial_unit (i), t::spatial_unit (3 * i),
+                                               t::spatial_unit (7 * i));
+
+                     const t::vector3su b (t::spatial_unit (11), t::spatial_unit (13),
+                                           t::spatial_unit (17));
+
+                     return [a, out, b] {
+                       for (size_t i = 0; i < PRIMITIVE_N; ++i)
+                         (*out)[i] = (*a)[i] - b;
+
+                       keep (out->data ());
+                     };
+                   } });
+
+  list.push_back ({ "vector3f a * s + b", PRIMITIVE_N, [] {
+                     auto a = std::make_shared<std::vector<t::vector3f>> (PRIMITIVE_N);
+                     auto out = std::make_shared<std::vector<t::vector3f>> (PRIMITIVE_N);
+
+                     for (size_t i = 0; i < PRIMITIVE_N; ++i)
+                       (*a)[i] = t::vector3f (i, 0.5 * i, -0.25 * i);
+
+                     const t::vector3f b (1.0, 2.0, 3.0);
+
+                     return [a, out, b] {
+                       for (size_t i = 0; i < PRIMITIVE_N; ++i)
+                         (*out)[i] = (*a)[i] * 1.5 + b;
+
+                       keep (out->data ());
+                     };
+                   } });
+
+  list.push_back ({ "vector3f::distance", PRIMITIVE_N, [] {
+                     auto a = std::make_shared<std::vector<t::vector3f>> (PRIMITIVE_N);
+                     auto out = std::make_shared<std::vector<double>> (PRIMITIVE_N);
+
+                     for (size_t i = 0; i < PRIMITIVE_N; ++i)
+                       (*a)[i] = t::vector3f (i, 0.5 * i, -0.25 * i);
+
+                     const t::vector3f b (1.0, 2.0, 3.0);
+
+                     return [a, out, b] {
+                       for (size_t i = 0; i < PRIMITIVE_N; ++i)
+                         (*out)[i] = (*a)[i].distance (b);
+
+                       keep (out->data ());
+                     };
+                   } });
+
+  list.push_back ({ "project", PRIMITIVE_N, [] {
+                     auto bodies = std::make_shared<std::vector<Body>> ();
+                     auto out = std::make_shared<std::vector<t::vector3f>> (PRIMITIVE_N);
+                     std::vector<uint8_t> colors;
+
+                     synthetic_catalog (PRIMITIVE_N, *bodies, colors);
+
+                     const Camera camera = bench_camera ();
+
+                     return [bodies, out, camera] {
+                       for (size_t i = 0; i < PRIMITIVE_N; ++i)
+                         (*out)[i] = project (camera, (*bodies)[i].position);
+
+                       keep (out->data ());
+                     };
+                   } });
+
+  list.push_back ({ "Projection::apply", PRIMITIVE_N, [] {
+                     auto bodies = std::make_shared<std::vector<Body>> ();
+                     auto out = std::make_shared<std::vector<t::vector3f>> (PRIMITIVE_N);
+                     std::vector<uint8_t> colors;
+
+                     synthetic_catalog (PRIMITIVE_N, *bodies, colors);
+
+                     const Projection projection (bench_camera ());
+
+                     return [bodies, out, projection] {
+                       for (size_t i = 0; i < PRIMITIVE_N; ++i)
+                         (*out)[i] = projection.apply ((*bodies)[i].position);
+
+                       keep (out->data ());
+                     };
+                   } });
+
+  list.push_back ({ "applyIntensity_uint8", PRIMITIVE_N, [] {
+                     auto out = std::make_shared<std::vector<uint8_t>> (3 * PRIMITIVE_N);
+
+                     return [out] {
+                       uint8_t *o = out->data ();
+
+                       for (size_t i = 0; i < PRIMITIVE_N; ++i)
+                         applyIntensity_uint8 (i & 255, (i >> 2) & 255, (i >> 4) & 255,
+                                               i * 1e-3, o[3 * i], o[3 * i + 1], o[3 * i + 2]);
+
+                       keep (out->data ());
+                     };
+                   } });
+
+  list.push_back ({ "shade_color", PRIMITIVE_N, [] {
+                     auto out = std::make_shared<std::vector<Star_Sample>> (PRIMITIVE_N);
+
+                     const Exposure exposure (bench_camera ());
+
+                     return [out, exposure] {
+                       for (size_t i = 0; i < PRIMITIVE_N; ++i)
+                         shade_color (exposure, i & 255, i * 1e-3, (*out)[i]);
+
+                       keep (out->data ());
+                     };
+                   } });
+
+  // The whole per-star step of the renderer, single-threaded and across the OpenMP pool, over
+  // catalogs that fit in cache and ones that do not.
+  for (size_t n = 10000; n <= max_stars; n *= 10)
+    for (bool parallel : { false, true })
+      list.push_back ({ std::string (parallel ? "shade_star omp" : "shade_star") + " "
+                            + std::to_string (n),
+                        n, [n, parallel] {
+                          auto bodies = std::make_shared<std::vector<Body>> ();
+                          auto colors = std::make_shared<std::vector<uint8_t>> ();
+                          auto out = std::make_shared<std::vector<Star_Sample>> (n);
+
+                          synthetic_catalog (n, *bodies, *colors);
+
+                          const Camera camera = bench_camera ();
+
+                          return [bodies, colors, out, camera, n, parallel] {
+                            const Projection projection (camera);
+                            const Exposure exposure (camera);
+
+                            const Body *b = bodies->data ();
+                            const uint8_t *c = colors->data ();
+                            Star_Sample *o = out->data ();
+
+#pragma omp parallel for schedule(static) if (parallel)
+                            for (size_t i = 0; i < n; ++i)
+                              if (!shade_star (projection, exposure, b[i], c[i], o[i]))
+                                o[i].a = 0;
+
+                            keep (out->data ());
+                          };
+                        } });
+
+  // Re-framing whole catalogs: rotation between Cartesian frames, and to spherical coordinates.
+  for (size_t n = 10000; n <= max_stars; n *= 10)
+    for (bool spherical : { false, true })
+      list.push_back ({ std::string (spherical ? "to_spherical_batch" : "transform_batch") + " "
+                            + std::to_string (n),
+                        n, [n, spherical] {
+                          auto bodies = std::make_shared<std::vector<Body>> ();
+                          auto positions = std::make_shared<std::vector<t::vector3su>> (n);
+                          auto out = std::make_shared<std::vector<t::vector3su>> (n);
+                          auto angles = std::make_shared<std::vector<t::spherical>> (n);
+                          std::vector<uint8_t> colors;
+
+                          synthetic_catalog (n, *bodies, colors);
+
+                          for (size_t i = 0; i < n; ++i)
+                            (*positions)[i] = (*bodies)[i].position;
+
+                          return [positions, out, angles, n, spherical] {
+                            if (spherical)
+                              t::to_spherical_batch (t::frame::icrs, t::frame::galactic,
+                                                     positions->data (), n, angles->data ());
+                            else
+                              t::transform_batch (t::frame::icrs, t::frame::galactic,
+                                                  positions->data (), n, out->data ());
+
+                            keep (out->data ());
+                            keep (angles->data ());
+                          };
+                        } });
+
+  return list;
+}
+
+int
+usage ()
+{
+  std::fprintf (stderr, "usage: bench.out [FILTER] [--reps N] [--max-stars N]\n");
+  return 1;
+}
+} // namespace
+
+int
+main (int argc, char *argv[])
+{
+  std::string filter;
+  int reps = 15;
+  size_t max_stars = 1000000;
+
+  for (int i = 1; i < argc; ++i)
+    {
+      if (std::strcmp (argv[i], "--reps") == 0 && i + 1 < argc)
+        reps = std::max (std::atoi (argv[++i]), 1);
+      else if (std::strcmp (argv[i], "--max-stars") == 0 && i + 1 < argc)
+        max_stars = std::strtoull (argv[++i], nullptr, 10);
+      else if (argv[i][0] != '-' && filter.empty ())
+        filter = argv[i];
+      else
+        return usage ();
+    }
+
+  std::printf ("%d sample(s) of at least %.0f ms each, %d OpenMP thread(s)\n\n", reps, SAMPLE_MS,
+               omp_get_max_threads ());
+
+  std::printf ("%-28s %10s %10s %10s %12s\n", "benchmark", "ns/op", "+- MAD", "min", "Mop/s");
+
+  for (const auto &benchmark : benchmarks (max_stars))
+    {
+      if (benchmark.name.find (filter) == std::string::npos)
+        continue;
+
+      const Result result = measure (benchmark.setup (), benchmark.n, reps);
+
+      std::printf ("%-28s %10.3f %10.3f %10.3f %12.2f\n", benchmark.name.c_str (),
+                   result.median_ns, result.mad_ns, result.min_ns, 1e3 / result.median_ns);
+    }
+
+  return 0;
+}
@@ -10,7 +10,12 @@ SELECT TOP 250000
   gs.ra,
   gs.dec,
   gs.parallax,
-  ap.lum_flame
+  ap.lum_flame,
+  gs.pmra,
+  gs.pmdec,
+  gs.radial_velocity,
+  gs.bp_rp,
+  ap.teff_gspphot
 
 FROM
   gaiadr3.gaia_source AS gs
@@ -0,0 +1,231 @@
+#include "batch.hpp"
+#include "camera.hpp"
+#include "catalog.hpp"
+#include "common.hpp"
+#include "index.hpp"
+#include "render.hpp"
+
+#include <SFML/Graphics.hpp>
+#include <omp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+struct Keyframe
+{
+  int frame;
+  Camera camera;
+};
+
+bool
+load_script (const std::string &path, std::vector<Keyframe> &keyframes)
+{
+  std::ifstream file (path);
+
+  if (!file.is_open ())
+    return false;
+
+  std::string line;
+
+  while (std::getline (file, line))
+    {
+      if (line.empty () || line[0] == '#')
+        continue;
+
+      std::stringstream ss (line);
+
+      Keyframe keyframe;
+
+      if (!(ss >> keyframe.frame) || !read_camera (ss, keyframe.camera))
+        return false;
+
+      keyframes.push_back (keyframe);
+    }
+
+  std::sort (keyframes.begin (), keyframes.end (),
+             [] (const Keyframe &a, const Keyframe &b) { return a.frame < b.frame; });
+
+  return !keyframes.empty ();
+}
+
+Camera
+interpolate (const std::vector<Keyframe> &keyframes, int frame)
+{
+  auto next = std::upper_bound (keyframes.begin (), keyframes.end (), frame,
+                                [] (int f, const Keyframe &k) { return f < k.frame; });
+
+  if (next == keyframes.begin ())
+    return next->camera;
+
+  if (next == keyframes.end ())
+    return keyframes.back ().camera;
+
+
+  const auto &k0 = *(next - 1);
+  const auto &k1 = *next;
+
+  const double s = static_cast<double> (frame - k0.frame) / (k1.frame - k0.frame);
+
+  const auto &a = k0.camera;
+  const auto &b = k1.camera;
+
+  auto lerp = [s] (double u, double v) { return u + (v - u) * s; };
+
+  Camera camera = a;
+
+  camera.position = a.position + (b.position - a.position) * s;
+  camera.y = a.y + std::remainder (b.y - a.y, TAU) * s;
+  camera.p = lerp (a.p, b.p);
+  camera.focal_length = lerp (a.focal_length, b.focal_length);
+  camera.f = lerp (a.f, b.f);
+  camera.t = std::exp (lerp (std::log (a.t), std::log (b.t)));
+  camera.iso = std::exp (lerp (std::log (a.iso), std::log (b.iso)));
+
+  return camera;
+}
+
+int
+usage ()
+{
+  std::cerr << "usage: render SCRIPT OUTDIR [--size WxH] [--ppm] [--catalog PATH]...\n";
+  return 1;
+}
+} // namespace
+
+bool
+read_camera (std::istream &in, Camera &camera)
+{
+  double x, y, z, yaw, pitch;
+
+  if (!(in >> x >> y >> z >> yaw >> pitch >> camera.focal_length >> camera.f >> camera.t
+        >> camera.iso))
+    return false;
+
+  camera.position = t::vector3su (t::spatial_unit::from_pc (x), t::spatial_unit::from_pc (y),
+                                  t::spatial_unit::from_pc (z));
+  camera.y = RAD (yaw);
+  camera.p = RAD (pitch);
+
+  return true;
+}
+
+int
+render_main (int argc, char *argv[])
+{
+  if (argc < 3)
+    return usage ();
+
+  const std::string script_path = argv[1];
+  const std::string output = argv[2];
+
+  uint32_t width = WW, height = WH;
+  bool ppm = false;
+  std::vector<std::string> catalog_paths;
+
+  for (int i = 3; i < argc; ++i)
+    {
+      if (std::strcmp (argv[i], "--size") == 0 && i + 1 < argc)
+        {
+          if (std::sscanf (argv[++i], "%ux%u", &width, &height) != 2 || !width || !height)
+            return usage ();
+        }
+      else if (std::strcmp (argv[i], "--ppm") == 0)
+        ppm = true;
+      else if (std::strcmp (argv[i], "--catalog") == 0 && i + 1 < argc)
+        catalog_paths.push_back (argv[++i]);
+      else
+        return usage ();
+    }
+
+  std::vector<Keyframe> keyframes;
+
+  if (!load_script (script_path, keyframes))
+    {
+      std::cerr << "ERROR: failed to load camera script.\n";
+      return 1;
+    }
+
+  if (catalog_paths.empty ())
+    catalog_paths.push_back ("gaia/data.csv");
+
+  Catalog catalog;
+
+  if (!load_catalog (catalog_paths, catalog))
+    {
+      std::cerr << "ERROR: failed to load catalog.\n";
+      return 1;
+    }
+
+  Body_Index index;
+
+  index.build (catalog);
+
+  const int first = keyframes.front ().frame;
+  const int last = keyframes.back ().frame;
+
+  std::atomic<int> failed{ 0 };
+
+  const auto start = std::chrono::steady_clock::now ();
+
+#pragma omp parallel
+  {
+    Framebuffer framebuffer (width, height);
+    std::vector<uint8_t> rgba;
+    sf::Image image;
+
+#pragma omp for schedule(dynamic, 1)
+    for (int frame = first; frame <= last; ++frame)
+      {
+        Camera camera = interpolate (keyframes, frame);
+
+        camera.d = camera_distance (camera, width);
+
+        framebuffer.clear (12, 12, 12);
+
+        render_stars (catalog, index, camera, false, framebuffer);
+
+        char path[4096];
+        snprintf (path, sizeof path, "%s/frame_%06d.%s", output.c_str (), frame,
+                  ppm ? "ppm" : "png");
+
+        bool ok;
+
+        if (ppm)
+          ok = framebuffer.write_ppm (path);
+        else
+          {
+            framebuffer.resolve (rgba);
+            image.create (width, height, rgba.data ());
+            ok = image.saveToFile (path);
+          }
+
+        if (!ok)
+          failed++;
+      }
+  }
+
+  const auto end = std::chrono::steady_clock::now ();
+
+  const double seconds = std::chrono::duration<double> (end - start).count ();
+  const int frames = last - first + 1;
+
+  fprintf (stderr, "%d frame(s) in %.2fs, %.2f frames/s on %d thread(s)\n", frames, seconds,
+           frames / seconds, omp_get_max_threads ());
+
+  if (failed)
+    {
+      std::cerr << "ERROR: failed to write " << failed << " frame(s).\n";
+      return 1;
+    }
+
+  return 0;
+}
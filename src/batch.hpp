@@ -0,0 +1,24 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <istream>
+
+#include "camera.hpp"
+
+// Reads `x_pc y_pc z_pc yaw_deg pitch_deg focal_length_mm f t iso`; `d` is left to the caller,
+// which knows the image width.
+bool read_camera (std::istream &in, Camera &camera);
+
+// Renders a camera keyframe script to numbered images, without opening a window:
+//
+//   render SCRIPT OUTDIR [--size WxH] [--ppm] [--catalog PATH]
+//
+// Each non-empty script line that does not start with '#' is a keyframe:
+//
+//   frame x_pc y_pc z_pc yaw_deg pitch_deg focal_length_mm f t iso
+//
+// Frames between keyframes are interpolated linearly (yaw along the shorter arc). Frames are
+// independent, so they are spread across cores, each thread with its own framebuffer.
+int render_main (int argc, char *argv[]);
+
+#endif // BATCH_HPP
@@ -0,0 +1,153 @@
+#ifndef CAMERA_HPP
+#define CAMERA_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "tachyon.hpp"
+
+namespace t = tachyon;
+
+#if 0
+constexpr uint32_t WW = 800;
+constexpr uint32_t WH = 600;
+#else
+constexpr uint32_t WW = 1920;
+constexpr uint32_t WH = 1080;
+#endif
+
+constexpr uint32_t FPS = 144;
+
+struct Camera
+{
+  t::vector3su position;
+  double y;
+  double p;
+  double d;
+
+  double focal_length;
+
+  double f;
+  double t;
+  double iso;
+
+  double N_photon = 1e6;
+};
+
+// Horizontal field of view of a 36 mm sensor behind the camera's lens.
+inline double
+camera_fov (const Camera &camera)
+{
+  return 2 * atan (36 / (2 * camera.focal_length));
+}
+
+// Distance from the eye to an image plane `width` pixels wide.
+inline double
+camera_distance (const Camera &camera, double width)
+{
+  return width / (2.0 * tan (camera_fov (camera) / 2.0));
+}
+
+struct Projection
+{
+  t::vector3su position;
+
+  double cos_y, sin_y;
+  double cos_p, sin_p;
+  double d;
+
+  double half_width, half_height;
+
+  Projection (const Camera &camera, double width = WW, double height = WH)
+      : position (camera.position), cos_y (cos (camera.y)), sin_y (sin (camera.y)),
+        cos_p (cos (camera.p)), sin_p (sin (camera.p)), d (camera.d), half_width (width / 2.0),
+        half_height (height / 2.0)
+  {
+  }
+
+  // Camera-space coordinates in Mm; y is the depth along the view axis.
+  t::vector3f
+  view (const t::vector3su &point) const
+  {
+    const auto distance = point - position;
+
+    return rotate (distance.x.as_Mm (), distance.y.as_Mm (), distance.z.as_Mm ());
+  }
+
+  // Camera-space coordinates of a world-space offset (Mm) from the camera.
+  t::vector3f
+  rotate (double tx, double ty, double tz) const
+  {
+    double rx = -ty * cos_y + tx * sin_y;
+    double ry = tx * cos_y + ty * sin_y;
+    double rz = tz * cos_p - ry * sin_p;
+
+    ry = tz * sin_p + ry * cos_p;
+
+    return t::vector3f{ rx, ry, rz };
+  }
+
+  // Unit world-space direction of the ray through screen pixel (sx, sy).
+  t::vector3f
+  unproject (double sx, double sy) const
+  {
+    const double rx = -(sx - half_width) / d;
+    const double rz = -(sy - half_height) / d;
+    const double ry = 1.0;
+
+    const double tz = rz * cos_p + ry * sin_p;
+    const double py = -rz * sin_p + ry * cos_p;
+
+    const double tx = rx * sin_y + py * cos_y;
+    const double ty = -rx * cos_y + py * sin_y;
+
+    const double length = std::sqrt (tx * tx + ty * ty + tz * tz);
+
+    return t::vector3f{ tx / length, ty / length, tz / length };
+  }
+
+  // Half-angle of a cone around the view axis that contains the whole image.
+  double
+  half_angle () const
+  {
+    return atan (std::sqrt (half_width * half_width + half_height * half_height) / d);
+  }
+
+  t::vector3f
+  apply (const t::vector3su &point) const
+  {
+    return screen (view (point));
+  }
+
+  // Screen position and depth of a camera-space point; zero when it is behind the camera.
+  t::vector3f
+  screen (const t::vector3f &r) const
+  {
+    if (r.y <= 0)
+      return tachyon::vector3f::ZERO;
+
+    const auto sx = r.x / -r.y * d + half_width;
+    const auto sy = r.z / -r.y * d + half_height;
+    const auto sz = r.y;
+
+    return tachyon::vector3f{ sx, sy, sz };
+  }
+};
+
+inline t::vector3f
+project (Camera camera, const t::vector3su &point)
+{
+  return Projection (camera).apply (point);
+}
+
+inline void
+project_batch (const Camera &camera, const t::vector3su *points, size_t n, t::vector3f *out)
+{
+  const Projection projection (camera);
+
+  for (size_t i = 0; i < n; ++i)
+    out[i] = projection.apply (points[i]);
+}
+
+#endif // CAMERA_HPP
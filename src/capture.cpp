@@ -0,0 +1,516 @@
+#include "capture.hpp"
+
+#include <SFML/Graphics.hpp>
+#include <SFML/OpenGL.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <initializer_list>
+#include <iostream>
+
+#ifndef GLAPIENTRY
+#define GLAPIENTRY
+#endif
+
+namespace
+{
+// Buffer object entry points are not in the OpenGL 1.1 headers, so they are looked up at run time.
+constexpr GLenum PIXEL_PACK_BUFFER = 0x88EB;
+constexpr GLenum STREAM_READ = 0x88E1;
+constexpr GLenum READ_ONLY = 0x88B8;
+
+struct Gl_Buffers
+{
+  void (GLAPIENTRY *gen) (GLsizei, GLuint *);
+  void (GLAPIENTRY *bind) (GLenum, GLuint);
+  void (GLAPIENTRY *data) (GLenum, std::ptrdiff_t, const void *, GLenum);
+  void *(GLAPIENTRY *map) (GLenum, GLenum);
+  GLboolean (GLAPIENTRY *unmap) (GLenum);
+} gl;
+
+template <typename F>
+bool
+load (F &f, const char *name)
+{
+  f = reinterpret_cast<F> (sf::Context::getFunction (name));
+  return f != nullptr;
+}
+} // namespace
+
+Capture::Capture (uint32_t _width, uint32_t _height, std::string _directory)
+    : width (_width), height (_height), directory (std::move (_directory))
+{
+  // Files are prefixed with the start time, so a new session never overwrites an old one.
+  const std::time_t now = std::time (nullptr);
+  char stamp[32];
+
+  std::strftime (stamp, sizeof stamp, "%Y%m%d_%H%M%S", std::localtime (&now));
+  prefix = stamp;
+
+  encoder = std::thread (&Capture::run, this);
+}
+
+// No GL work here: the context may be gone by now, so finish() must have collected the reads.
+Capture::~Capture ()
+{
+  {
+    std::lock_guard<std::mutex> lock (mutex);
+    quit = true;
+  }
+
+  wake.notify_one ();
+  encoder.join ();
+}
+
+bool
+Capture::start (Capture_Format _format, double _fps)
+{
+  std::error_code error;
+
+  std::filesystem::create_directories (directory, error);
+
+  if (error)
+    {
+      std::cerr << "ERROR: failed to create `" << directory << "`.\n";
+      return false;
+    }
+
+  allocate_pool ();
+
+  format = _format;
+  fps = _fps;
+  recording = true;
+  grabbed = 0;
+  dropped = 0;
+  written = 0;
+  next_time = -1.0;
+  next_number = 0;
+  recording_count++;
+
+  return true;
+}
+
+void
+Capture::stop ()
+{
+  if (!recording)
+    return;
+
+  recording = false;
+
+  // Reads still in flight belong to this recording and must reach the encoder before it closes.
+  collect_all ();
+  submit ({ JOB_CLOSE, format, recording_count, 0, nullptr });
+}
+
+void
+Capture::finish ()
+{
+  stop ();
+  collect_all ();
+
+  // Once the encoder has handed every buffer back, the pool goes until the next capture.
+  std::unique_lock<std::mutex> lock (mutex);
+
+  idle.wait (lock, [this] { return free_buffers.size () == storage.size (); });
+
+  free_buffers.clear ();
+  storage.clear ();
+}
+
+void
+Capture::screenshot ()
+{
+  allocate_pool ();
+
+  screenshot_requested = true;
+}
+
+void
+Capture::allocate_pool ()
+{
+  std::lock_guard<std::mutex> lock (mutex);
+
+  if (!storage.empty ())
+    return;
+
+  storage.resize (POOL_SIZE);
+
+  for (auto &buffer : storage)
+    {
+      buffer.resize (4 * static_cast<size_t> (width) * height);
+      free_buffers.push_back (&buffer);
+    }
+}
+
+void
+Capture::grab (double now)
+{
+  frame_count++;
+
+  // A read started PBO_COUNT - 1 frames ago has long finished its transfer; mapping it is free.
+  for (int slot = 0; slot < PBO_COUNT; ++slot)
+    if (pending_used[slot] && frame_count - pending_frame[slot] >= PBO_COUNT - 1)
+      collect (slot);
+
+  if (recording)
+    {
+      const double interval = 1.0 / fps;
+
+      if (next_time < 0.0)
+        next_time = now;
+
+      if (now >= next_time)
+        {
+          next_time += interval;
+
+          // The render loop fell behind the capture rate; those frames are gone.
+          if (now >= next_time)
+            {
+              const auto missed = static_cast<uint64_t> ((now - next_time) / interval) + 1;
+
+              dropped += missed;
+              next_number += missed;
+              next_time += missed * interval;
+            }
+
+          start_read ({ JOB_FRAME, format, recording_count, next_number++, nullptr });
+        }
+    }
+
+  if (screenshot_requested)
+    {
+      screenshot_requested = false;
+
+      std::error_code error;
+      std::filesystem::create_directories (directory, error);
+
+      start_read ({ JOB_SCREENSHOT, CAPTURE_PNG, 0, screenshot_count++, nullptr });
+    }
+}
+
+void
+Capture::init_pbo ()
+{
+  pbo_tried = true;
+
+  if (!load (gl.gen, "glGenBuffers") || !load (gl.bind, "glBindBuffer")
+      || !load (gl.data, "glBufferData") || !load (gl.map, "glMapBuffer")
+      || !load (gl.unmap, "glUnmapBuffer"))
+    {
+      std::cerr << "WARNING: no pixel buffer objects, capture reads back synchronously.\n";
+      return;
+    }
+
+  gl.gen (PBO_COUNT, pbo);
+
+  for (int slot = 0; slot < PBO_COUNT; ++slot)
+    {
+      gl.bind (PIXEL_PACK_BUFFER, pbo[slot]);
+      gl.data (PIXEL_PACK_BUFFER, 4 * static_cast<std::ptrdiff_t> (width) * height, nullptr,
+               STREAM_READ);
+    }
+
+  gl.bind (PIXEL_PACK_BUFFER, 0);
+
+  pbo_ready = true;
+}
+
+void
+Capture::start_read (Job job)
+{
+  if (!pbo_tried)
+    init_pbo ();
+
+  glPixelStorei (GL_PACK_ALIGNMENT, 1);
+
+  if (!pbo_ready)
+    {
+      job.pixels = acquire ();
+
+      if (!job.pixels)
+        {
+          if (job.kind == JOB_FRAME)
+            dropped++;
+          return;
+        }
+
+      glReadPixels (0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, job.pixels->data ());
+
+      if (job.kind == JOB_FRAME)
+        grabbed++;
+
+      submit (job);
+      return;
+    }
+
+  int slot = -1;
+
+  for (int s = 0; s < PBO_COUNT && slot < 0; ++s)
+    if (!pending_used[s])
+      slot = s;
+
+  // Every slot busy (a screenshot on top of a recording): finish the oldest read now.
+  if (slot < 0)
+    {
+      slot = 0;
+
+      for (int s = 1; s < PBO_COUNT; ++s)
+        if (pending_frame[s] < pending_frame[slot])
+          slot = s;
+
+      collect (slot);
+    }
+
+  // With a pack buffer bound, the pointer argument is an offset and the call returns at once.
+  gl.bind (PIXEL_PACK_BUFFER, pbo[slot]);
+  glReadPixels (0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  gl.bind (PIXEL_PACK_BUFFER, 0);
+
+  pending[slot] = job;
+  pending_used[slot] = true;
+  pending_frame[slot] = frame_count;
+}
+
+void
+Capture::collect (int slot)
+{
+  Job job = pending[slot];
+
+  pending_used[slot] = false;
+
+  job.pixels = acquire ();
+
+  if (!job.pixels)
+    {
+      if (job.kind == JOB_FRAME)
+        dropped++;
+      return;
+    }
+
+  gl.bind (PIXEL_PACK_BUFFER, pbo[slot]);
+
+  const void *data = gl.map (PIXEL_PACK_BUFFER, READ_ONLY);
+
+  if (data)
+    {
+      std::memcpy (job.pixels->data (), data, job.pixels->size ());
+      gl.unmap (PIXEL_PACK_BUFFER);
+    }
+
+  gl.bind (PIXEL_PACK_BUFFER, 0);
+
+  if (!data)
+    {
+      release (job.pixels);
+
+      if (job.kind == JOB_FRAME)
+        dropped++;
+      return;
+    }
+
+  if (job.kind == JOB_FRAME)
+    grabbed++;
+
+  submit (job);
+}
+
+void
+Capture::collect_all ()
+{
+  // Oldest first, so frames reach the encoder in order.
+  for (;;)
+    {
+      int slot = -1;
+
+      for (int s = 0; s < PBO_COUNT; ++s)
+        if (pending_used[s] && (slot < 0 || pending_frame[s] < pending_frame[slot]))
+          slot = s;
+
+      if (slot < 0)
+        break;
+
+      collect (slot);
+    }
+}
+
+std::vector<uint8_t> *
+Capture::acquire ()
+{
+  std::lock_guard<std::mutex> lock (mutex);
+
+  if (free_buffers.empty ())
+    return nullptr;
+
+  auto *buffer = free_buffers.back ();
+  free_buffers.pop_back ();
+
+  return buffer;
+}
+
+void
+Capture::release (std::vector<uint8_t> *buffer)
+{
+  std::lock_guard<std::mutex> lock (mutex);
+
+  free_buffers.push_back (buffer);
+}
+
+void
+Capture::submit (Job job)
+{
+  {
+    std::lock_guard<std::mutex> lock (mutex);
+    queue.push_back (job);
+  }
+
+  wake.notify_one ();
+}
+
+void
+Capture::run ()
+{
+  std::unique_lock<std::mutex> lock (mutex);
+
+  for (;;)
+    {
+      wake.wait (lock, [this] { return quit || !queue.empty (); });
+
+      if (queue.empty ())
+        break;
+
+      const Job job = queue.front ();
+      queue.pop_front ();
+
+      lock.unlock ();
+      encode (job);
+      lock.lock ();
+
+      if (job.pixels)
+        {
+          free_buffers.push_back (job.pixels);
+          idle.notify_all ();
+        }
+    }
+}
+
+void
+Capture::encode (const Job &job)
+{
+  char path[512];
+
+  switch (job.kind)
+    {
+    case JOB_CLOSE:
+      if (y4m.is_open () && y4m_recording == job.recording)
+        y4m.close ();
+      break;
+
+    case JOB_SCREENSHOT:
+    case JOB_FRAME:
+      if (job.kind == JOB_FRAME && job.format == CAPTURE_Y4M)
+        {
+          write_y4m (job);
+          break;
+        }
+
+      if (job.kind == JOB_SCREENSHOT)
+        snprintf (path, sizeof path, "%s/%s_shot%03lu.png", directory.c_str (), prefix.c_str (),
+                  job.number);
+      else
+        snprintf (path, sizeof path, "%s/%s_rec%02lu_%06lu.png", directory.c_str (),
+                  prefix.c_str (), job.recording, job.number);
+
+      {
+        sf::Image image;
+
+        image.create (width, height, job.pixels->data ());
+        image.flipVertically ();
+
+        if (!image.saveToFile (path))
+          {
+            std::cerr << "ERROR: failed to write `" << path << "`.\n";
+            break;
+          }
+      }
+
+      written++;
+      break;
+    }
+}
+
+// Raw 4:2:0 YUV with full-range BT.601 coefficients (C420jpeg), converted on the encoder thread.
+void
+Capture::write_y4m (const Job &job)
+{
+  if (!y4m.is_open () || y4m_recording != job.recording)
+    {
+      char path[512];
+
+      snprintf (path, sizeof path, "%s/%s_rec%02lu.y4m", directory.c_str (), prefix.c_str (),
+                job.recording);
+
+      y4m.close ();
+      y4m.open (path, std::ios::binary);
+      y4m_recording = job.recording;
+
+      if (!y4m.is_open ())
+        {
+          std::cerr << "ERROR: failed to open `" << path << "`.\n";
+          return;
+        }
+
+      y4m << "YUV4MPEG2 W" << width << " H" << height << " F" << std::lround (fps * 1000)
+          << ":1000 Ip A1:1 C420jpeg\n";
+    }
+
+  const uint32_t cw = (width + 1) / 2;
+  const uint32_t ch = (height + 1) / 2;
+
+  scratch.resize (static_cast<size_t> (width) * height + 2 * static_cast<size_t> (cw) * ch);
+
+  uint8_t *Y = scratch.data ();
+  uint8_t *U = Y + static_cast<size_t> (width) * height;
+  uint8_t *V = U + static_cast<size_t> (cw) * ch;
+
+  const uint8_t *pixels = job.pixels->data ();
+
+  // OpenGL rows run bottom-up.
+  auto rgba = [&] (uint32_t x, uint32_t y) {
+    return pixels + 4 * (static_cast<size_t> (height - 1 - y) * width + x);
+  };
+
+  for (uint32_t y = 0; y < height; ++y)
+    for (uint32_t x = 0; x < width; ++x)
+      {
+        const uint8_t *p = rgba (x, y);
+
+        Y[static_cast<size_t> (y) * width + x] = (77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8;
+      }
+
+  for (uint32_t y = 0; y < ch; ++y)
+    for (uint32_t x = 0; x < cw; ++x)
+      {
+        int r = 0, g = 0, b = 0;
+
+        const uint32_t x1 = std::min (2 * x + 1, width - 1);
+        const uint32_t y1 = std::min (2 * y + 1, height - 1);
+
+        for (const uint8_t *p : { rgba (2 * x, 2 * y), rgba (x1, 2 * y), rgba (2 * x, y1),
+                                  rgba (x1, y1) })
+          r += p[0], g += p[1], b += p[2];
+
+        // Sum of four pixels; the extra >> 2 averages them.
+        U[static_cast<size_t> (y) * cw + x] = ((-43 * r - 85 * g + 128 * b + 512) >> 10) + 128;
+        V[static_cast<size_t> (y) * cw + x] = ((128 * r - 107 * g - 21 * b + 512) >> 10) + 128;
+      }
+
+  y4m << "FRAME\n";
+  y4m.write (reinterpret_cast<const char *> (scratch.data ()), scratch.size ());
+
+  written++;
+}
@@ -0,0 +1,133 @@
+#ifndef CAPTURE_HPP
+#define CAPTURE_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum Capture_Format
+{
+  CAPTURE_PNG,
+  CAPTURE_Y4M
+};
+
+// Screenshots and video recording off the render thread. grab() only starts an asynchronous read
+// of the back buffer into a ring of pixel buffer objects and collects the one started a few frames
+// earlier, copying it into a buffer from a fixed pool; a background thread encodes and writes it.
+// When the pool is exhausted the frame is dropped and counted rather than waited for. Without
+// pixel buffer objects it falls back to a direct glReadPixels, which still keeps encoding off the
+// render thread.
+struct Capture
+{
+  static constexpr int PBO_COUNT = 3;
+  static constexpr size_t POOL_SIZE = 8;
+
+  enum Job_Kind
+  {
+    JOB_FRAME,
+    JOB_SCREENSHOT,
+    JOB_CLOSE
+  };
+
+  struct Job
+  {
+    Job_Kind kind;
+    Capture_Format format;
+
+    // Recording the frame belongs to, and its number within it.
+    uint64_t recording;
+    uint64_t number;
+
+    // RGBA, bottom row first as OpenGL returns it; null for JOB_CLOSE.
+    std::vector<uint8_t> *pixels;
+  };
+
+  uint32_t width, height;
+  std::string directory;
+  std::string prefix;
+
+  Capture_Format format{ CAPTURE_PNG };
+  double fps{ 60.0 };
+
+  bool recording{ false };
+
+  // Frames handed to the encoder and frames lost to a full pool or a late render loop, for the
+  // current recording.
+  uint64_t grabbed{ 0 };
+  uint64_t dropped{ 0 };
+
+  Capture (uint32_t _width, uint32_t _height, std::string _directory);
+  ~Capture ();
+
+  Capture (const Capture &) = delete;
+  Capture &operator= (const Capture &) = delete;
+
+  bool start (Capture_Format _format, double _fps);
+  void stop ();
+
+  // Stops recording, hands every read still in flight to the encoder and frees the buffer pool once
+  // it is done with them. Call while the GL context is current, before the window closes; the
+  // destructor only waits for the encoder.
+  void finish ();
+
+  // Saves the next grabbed frame as a PNG, whether or not a recording is running.
+  void screenshot ();
+
+  // Call after the frame is drawn and before display(), with the current time in seconds.
+  void grab (double now);
+
+  // Render thread state.
+  bool pbo_tried{ false };
+  bool pbo_ready{ false };
+  unsigned pbo[PBO_COUNT]{};
+  Job pending[PBO_COUNT]{};
+  bool pending_used[PBO_COUNT]{};
+  uint64_t pending_frame[PBO_COUNT]{};
+  uint64_t frame_count{ 0 };
+
+  // Number of the recording's next frame, counted as reads start; grabbed only moves once a read
+  // is collected, frames later.
+  uint64_t next_number{ 0 };
+  uint64_t recording_count{ 0 };
+  uint64_t screenshot_count{ 0 };
+  bool screenshot_requested{ false };
+  double next_time{ -1.0 };
+
+  // Shared with the encoder. The pool is allocated by the first start() or screenshot() and
+  // released by finish().
+  std::vector<std::vector<uint8_t>> storage;
+  std::vector<std::vector<uint8_t> *> free_buffers;
+  std::deque<Job> queue;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable idle;
+  bool quit{ false };
+
+  std::atomic<uint64_t> written{ 0 };
+
+  // Encoder state.
+  std::ofstream y4m;
+  uint64_t y4m_recording{ 0 };
+  std::vector<uint8_t> scratch;
+  std::thread encoder;
+
+  void allocate_pool ();
+  void init_pbo ();
+  void start_read (Job job);
+  void collect (int slot);
+  void collect_all ();
+  std::vector<uint8_t> *acquire ();
+  void release (std::vector<uint8_t> *buffer);
+  void submit (Job job);
+  void encode (const Job &job);
+  void write_y4m (const Job &job);
+  void run ();
+};
+
+#endif // CAPTURE_HPP
@@ -0,0 +1,780 @@
+#include "catalog.hpp"
+#include "common.hpp"
+#include "pack.hpp"
+#include "palette.hpp"
+#include "tachyon_frame.hpp"
+
+#include <malloc.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <utility>
+
+// Next comma-separated field as a double, leaving `p` on the field after it; `missing` when it is
+// empty, not a number or the line has ended.
+static double
+field (const char *&p, double missing = 0.0)
+{
+  if (*p == '\n' || *p == '\r' || *p == '\0')
+    return missing;
+
+  char *end;
+  double value = std::strtod (p, &end);
+
+  if (end == p)
+    value = missing;
+
+  p = end;
+
+  while (*p != ',' && *p != '\n' && *p != '\0')
+    ++p;
+
+  if (*p == ',')
+    ++p;
+
+  return value;
+}
+
+bool
+Gaia_Object::from (const char *line, Gaia_Object &object)
+{
+  char *end;
+  object.source_id = std::strtoll (line, &end, 10);
+
+  const bool has_id = end != line;
+
+  const char *p = *end == ',' ? end + 1 : end;
+
+  // Required; NaN marks them missing.
+  object.ra = field (p, NAN);
+  object.dec = field (p, NAN);
+  object.parallax = field (p, NAN);
+  object.lum_flame = field (p, NAN);
+
+  object.pmra = field (p);
+  object.pmdec = field (p);
+  object.radial_velocity = field (p);
+  object.bp_rp = field (p, NAN);
+  object.teff_gspphot = field (p, NAN);
+
+  return has_id && std::isfinite (object.ra) && std::isfinite (object.dec)
+         && std::isfinite (object.parallax) && std::isfinite (object.lum_flame);
+}
+
+Body::Body (Gaia_Object object)
+{
+  double distance_pc = object.parallax != 0.0 ? 1000.0 / object.parallax : 0.0;
+
+  position = t::to_cartesian (
+      { RAD (object.ra), RAD (object.dec), t::spatial_unit::from_pc (distance_pc) });
+
+  luminosity = object.lum_flame;
+}
+
+vector3v
+velocity_of (const Gaia_Object &object)
+{
+  if (object.parallax <= 0.0)
+    return vector3v::ZERO;
+
+  // km/s per (mas/yr / mas), and km/s to Mm per Julian year.
+  static constexpr double K = 4.740470446;
+  static constexpr double KMS_TO_MM_YR = 1e-3 * 86400.0 * 365.25;
+
+  const double r_rad = RAD (object.ra);
+  const double d_rad = RAD (object.dec);
+
+  const double v_ra = K * object.pmra / object.parallax;
+  const double v_dec = K * object.pmdec / object.parallax;
+  const double v_r = object.radial_velocity;
+
+  const double cr = cos (r_rad), sr = sin (r_rad);
+  const double cd = cos (d_rad), sd = sin (d_rad);
+
+  const double vx = v_r * cd * cr - v_ra * sr - v_dec * sd * cr;
+  const double vy = v_r * cd * sr + v_ra * cr - v_dec * sd * sr;
+  const double vz = v_r * sd + v_dec * cd;
+
+  return vector3v (vx * KMS_TO_MM_YR, vy * KMS_TO_MM_YR, vz * KMS_TO_MM_YR);
+}
+
+uint8_t
+color_of (const Gaia_Object &object)
+{
+  if (object.teff_gspphot > 0.0)
+    return palette_index (object.teff_gspphot);
+
+  if (std::isfinite (object.bp_rp))
+    return palette_index (teff_from_bp_rp (object.bp_rp));
+
+  return PALETTE_LEGACY;
+}
+
+size_t
+Catalog::size () const
+{
+  return bodies.size ();
+}
+
+void
+Catalog::touch ()
+{
+  static std::atomic<uint64_t> last{ 0 };
+
+  revision = ++last;
+}
+
+void
+Catalog::propagate (double years)
+{
+  if (years == epoch)
+    return;
+
+  const size_t n = bodies.size ();
+
+  Body *body = bodies.data ();
+  const t::vector3su *p = epoch_positions.data ();
+  const vector3v *v = velocities.data ();
+
+  // Plain arithmetic on raw Mm values over flat arrays, so the loop vectorises.
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; ++i)
+    {
+      const int64_t x = p[i].x.as_Mm () + static_cast<int64_t> (v[i].x * years);
+      const int64_t y = p[i].y.as_Mm () + static_cast<int64_t> (v[i].y * years);
+      const int64_t z = p[i].z.as_Mm () + static_cast<int64_t> (v[i].z * years);
+
+      body[i].position.x = t::spatial_unit (x);
+      body[i].position.y = t::spatial_unit (y);
+      body[i].position.z = t::spatial_unit (z);
+    }
+
+  epoch = years;
+
+  touch ();
+}
+
+namespace
+{
+// Bytes of CSV read, split into lines and parsed at a time; with the dedup table this bounds what
+// a load holds beyond the catalog itself.
+constexpr size_t CHUNK_BYTES = size_t (1) << 24;
+
+constexpr uint32_t SKIP = UINT32_MAX;
+
+// source_id -> catalog row, split into linear-probing shards so each merge step can give every
+// shard to one thread.
+struct Merge_Index
+{
+  static constexpr int SHARD_BITS = 6;
+  static constexpr size_t SHARDS = size_t (1) << SHARD_BITS;
+
+  // Marks a row not yet placed in the catalog; the low bits count within the shard.
+  static constexpr uint32_t PENDING = 0x80000000;
+
+  static constexpr int64_t EMPTY = INT64_MIN;
+
+  struct Entry
+  {
+    int64_t source_id;
+    uint32_t row;
+
+    // One plus the chunk line that last claimed the row, while a chunk is being merged.
+    uint32_t claim;
+  };
+
+  struct Shard
+  {
+    std::vector<Entry> table;
+    size_t used{ 0 };
+    uint32_t fresh{ 0 };
+
+    Entry &find (int64_t source_id);
+    void grow ();
+    void resize (size_t size);
+  };
+
+  Shard shards[SHARDS];
+
+  static size_t
+  hash (int64_t source_id)
+  {
+    // Gaia source_ids carry their HEALPix cell in the high bits; mix before using any.
+    return static_cast<uint64_t> (source_id) * 0x9e3779b97f4a7c15;
+  }
+
+  // Maps the hash bits below those picking the shard onto [0, size).
+  static size_t
+  slot (int64_t source_id, size_t size)
+  {
+    return ((hash (source_id) >> (32 - SHARD_BITS) & 0xffffffff) * size) >> 32;
+  }
+
+  void reserve (size_t rows);
+
+  // Sets dest[i] to the catalog row line i of the chunk goes to, or SKIP when a later line of the
+  // chunk has the same source_id. New source_ids get rows from `rows` up; returns the new count.
+  size_t assign (const std::vector<int64_t> &ids, size_t rows, std::vector<uint32_t> &dest);
+};
+
+Merge_Index::Entry &
+Merge_Index::Shard::find (int64_t source_id)
+{
+  if (table.empty ())
+    grow ();
+
+  for (;;)
+    {
+      size_t i = slot (source_id, table.size ());
+
+      while (table[i].source_id != source_id && table[i].source_id != EMPTY)
+        i = i + 1 == table.size () ? 0 : i + 1;
+
+      Entry &e = table[i];
+
+      if (e.source_id == source_id)
+        return e;
+
+      // Only an insertion can fill the table; after growing, the free slot is looked for again.
+      if (10 * (used + 1) > 7 * table.size ())
+        {
+          grow ();
+          continue;
+        }
+
+      ++used;
+      e = { source_id, PENDING | fresh++, 0 };
+      return e;
+    }
+}
+
+void
+Merge_Index::Shard::grow ()
+{
+  resize (std::max<size_t> (2 * table.size (), 1024));
+}
+
+void
+Merge_Index::Shard::resize (size_t size)
+{
+  std::vector<Entry> old (size, Entry{ EMPTY, 0, 0 });
+
+  old.swap (table);
+
+  for (const Entry &e : old)
+    if (e.source_id != EMPTY)
+      {
+        size_t i = slot (e.source_id, table.size ());
+
+        while (table[i].source_id != EMPTY)
+          i = i + 1 == table.size () ? 0 : i + 1;
+
+        table[i] = e;
+      }
+}
+
+void
+Merge_Index::reserve (size_t rows)
+{
+  // Sized exactly rather than to a power of two, at most 70% full.
+  const size_t size = std::max<size_t> (rows / SHARDS * 10 / 7 + 1, 1024);
+
+  for (auto &shard : shards)
+    if (shard.table.size () < size)
+      shard.resize (size);
+}
+
+size_t
+Merge_Index::assign (const std::vector<int64_t> &ids, size_t rows, std::vector<uint32_t> &dest)
+{
+  // Stable counting sort of the chunk by shard keeps file order within each shard.
+  std::vector<uint32_t> order (ids.size ());
+  size_t first[SHARDS + 1] = {};
+
+  for (size_t i = 0; i < ids.size (); ++i)
+    ++first[(hash (ids[i]) >> (64 - SHARD_BITS)) + 1];
+
+  for (size_t s = 0; s < SHARDS; ++s)
+    first[s + 1] += first[s];
+
+  {
+    size_t next[SHARDS];
+
+    std::copy (first, first + SHARDS, next);
+
+    for (size_t i = 0; i < ids.size (); ++i)
+      order[next[hash (ids[i]) >> (64 - SHARD_BITS)]++] = i;
+  }
+
+  dest.assign (ids.size (), SKIP);
+
+#pragma omp parallel for schedule(dynamic)
+  for (size_t s = 0; s < SHARDS; ++s)
+    {
+      shards[s].fresh = 0;
+
+      for (size_t k = first[s]; k < first[s + 1]; ++k)
+        {
+          Entry &e = shards[s].find (ids[order[k]]);
+
+          if (e.claim)
+            dest[e.claim - 1] = SKIP;
+
+          e.claim = order[k] + 1;
+        }
+    }
+
+  size_t base[SHARDS + 1];
+
+  base[0] = rows;
+
+  for (size_t s = 0; s < SHARDS; ++s)
+    base[s + 1] = base[s] + shards[s].fresh;
+
+#pragma omp parallel for schedule(dynamic)
+  for (size_t s = 0; s < SHARDS; ++s)
+    for (size_t k = first[s]; k < first[s + 1]; ++k)
+      {
+        Entry &e = shards[s].find (ids[order[k]]);
+
+        if (!e.claim)
+          continue;
+
+        if (e.row & PENDING)
+          e.row = base[s] + (e.row & ~PENDING);
+
+        dest[e.claim - 1] = e.row;
+        e.claim = 0;
+      }
+
+  return base[SHARDS] - rows;
+}
+
+// source_id -> row of a catalog without duplicate source_ids; built once, then only read.
+struct Row_Lookup
+{
+  static constexpr uint32_t NONE = UINT32_MAX;
+
+  struct Entry
+  {
+    int64_t source_id;
+    uint32_t row;
+  };
+
+  std::vector<Entry> table;
+
+  Row_Lookup (const std::vector<int64_t> &source_ids);
+
+  uint32_t find (int64_t source_id) const;
+};
+
+Row_Lookup::Row_Lookup (const std::vector<int64_t> &source_ids)
+    : table (std::max<size_t> (2 * source_ids.size (), 16), Entry{ Merge_Index::EMPTY, NONE })
+{
+  for (size_t row = 0; row < source_ids.size (); ++row)
+    {
+      size_t i = Merge_Index::slot (source_ids[row], table.size ());
+
+      while (table[i].source_id != Merge_Index::EMPTY)
+        i = i + 1 == table.size () ? 0 : i + 1;
+
+      table[i] = { source_ids[row], static_cast<uint32_t> (row) };
+    }
+}
+
+uint32_t
+Row_Lookup::find (int64_t source_id) const
+{
+  for (size_t i = Merge_Index::slot (source_id, table.size ());;
+       i = i + 1 == table.size () ? 0 : i + 1)
+    {
+      if (table[i].source_id == source_id)
+        return table[i].row;
+
+      if (table[i].source_id == Merge_Index::EMPTY)
+        return NONE;
+    }
+}
+
+// FNV-1a over a CSV line, up to its newline or the end of the buffer.
+uint64_t
+line_hash (const char *line)
+{
+  uint64_t h = 0xcbf29ce484222325;
+
+  for (const char *p = line; *p && *p != '\n' && *p != '\r'; ++p)
+    h = (h ^ static_cast<uint8_t> (*p)) * 0x100000001b3;
+
+  return h;
+}
+
+void
+store (Catalog &catalog, size_t i, const Gaia_Object &object)
+{
+  catalog.bodies[i] = Body (object);
+  catalog.source_ids[i] = object.source_id;
+  catalog.epoch_positions[i] = catalog.bodies[i].position;
+  catalog.velocities[i] = velocity_of (object);
+  catalog.colors[i] = color_of (object);
+}
+
+// Copies a row that has not changed since `base` was loaded; body positions are left alone in
+// `base`, as they may be being propagated.
+void
+reuse (Catalog &catalog, size_t i, const Catalog &base, size_t row)
+{
+  catalog.bodies[i].position = base.epoch_positions[row];
+  catalog.bodies[i].luminosity = base.bodies[row].luminosity;
+  catalog.source_ids[i] = base.source_ids[row];
+  catalog.epoch_positions[i] = base.epoch_positions[row];
+  catalog.velocities[i] = base.velocities[row];
+  catalog.colors[i] = base.colors[row];
+}
+
+void
+reserve (Catalog &catalog, size_t rows, bool hashed)
+{
+  catalog.bodies.reserve (rows);
+  catalog.source_ids.reserve (rows);
+  catalog.epoch_positions.reserve (rows);
+  catalog.velocities.reserve (rows);
+  catalog.colors.reserve (rows);
+
+  if (hashed)
+    catalog.row_hashes.reserve (rows);
+}
+
+void
+resize (Catalog &catalog, size_t rows, bool hashed)
+{
+  catalog.bodies.resize (rows);
+  catalog.source_ids.resize (rows);
+  catalog.epoch_positions.resize (rows);
+  catalog.velocities.resize (rows);
+  catalog.colors.resize (rows);
+
+  if (hashed)
+    catalog.row_hashes.resize (rows);
+}
+
+size_t
+file_size (const std::string &path)
+{
+  std::ifstream file (path, std::ios::binary | std::ios::ate);
+
+  return file.is_open () ? static_cast<size_t> (file.tellg ()) : 0;
+}
+
+// With `base`, rows are hashed and unchanged ones copied from it, and `stats` compares the two
+// (see reload_gaia()).
+bool
+ingest (const std::vector<std::string> &paths, Catalog &catalog, const Catalog *base = nullptr,
+        Reload_Stats *stats = nullptr)
+{
+  catalog = Catalog ();
+
+  const bool hashed = base != nullptr;
+
+  // Rows of `base` by source_id, when it kept the hashes to compare against.
+  std::unique_ptr<Row_Lookup> lookup;
+
+  if (base && !base->row_hashes.empty ())
+    lookup = std::make_unique<Row_Lookup> (base->source_ids);
+
+  size_t bytes = 0;
+
+  for (const auto &path : paths)
+    bytes += file_size (path);
+
+  Merge_Index index;
+
+  // Sized once the first chunk gives the mean row length.
+  bool reserved = false;
+
+  std::vector<char> buffer;
+  std::vector<size_t> lines;
+  std::vector<int64_t> ids;
+  std::vector<uint32_t> dest;
+
+  for (const auto &path : paths)
+    {
+      std::ifstream file (path, std::ios::binary);
+
+      if (!file.is_open ())
+        return false;
+
+      std::string header;
+
+      std::getline (file, header);
+
+      size_t carry = 0;
+
+      while (true)
+        {
+          buffer.resize (carry + CHUNK_BYTES + 1);
+
+          file.read (buffer.data () + carry, CHUNK_BYTES);
+
+          const size_t end = carry + file.gcount ();
+          const bool last = !file;
+
+          if (file.bad ())
+            return false;
+
+          // Whole lines only, unless the file has ended without a final newline.
+          size_t stop = end;
+
+          while (!last && stop > 0 && buffer[stop - 1] != '\n')
+            --stop;
+
+          buffer[end] = '\0';
+
+          lines.clear ();
+
+          for (size_t i = 0; i < stop;)
+            {
+              const char *nl = static_cast<const char *> (
+                  std::memchr (buffer.data () + i, '\n', stop - i));
+
+              const size_t next = nl ? nl - buffer.data () + 1 : stop;
+
+              if (buffer[i] != '\n' && buffer[i] != '\r')
+                lines.push_back (i);
+
+              i = next;
+            }
+
+          if (!reserved && !lines.empty ())
+            {
+              // Estimated from the bytes per row seen so far, with a little slack.
+              const size_t rows = bytes / (stop / lines.size () + 1) * 21 / 20 + lines.size ();
+
+              reserve (catalog, rows, hashed);
+              index.reserve (rows);
+              reserved = true;
+            }
+
+          ids.resize (lines.size ());
+
+#pragma omp parallel for schedule(static)
+          for (size_t i = 0; i < lines.size (); ++i)
+            ids[i] = std::strtoll (buffer.data () + lines[i], nullptr, 10);
+
+          const size_t rows = catalog.size ();
+
+          resize (catalog, rows + index.assign (ids, rows, dest), hashed);
+
+          size_t invalid = 0;
+
+#pragma omp parallel for schedule(static) reduction(+ : invalid)
+          for (size_t i = 0; i < lines.size (); ++i)
+            {
+              if (dest[i] == SKIP)
+                continue;
+
+              const char *line = buffer.data () + lines[i];
+
+              if (hashed)
+                {
+                  const uint64_t h = line_hash (line);
+
+                  catalog.row_hashes[dest[i]] = h;
+
+                  const uint32_t row = lookup ? lookup->find (ids[i]) : Row_Lookup::NONE;
+
+                  if (row != Row_Lookup::NONE && base->row_hashes[row] == h)
+                    {
+                      reuse (catalog, dest[i], *base, row);
+                      continue;
+                    }
+                }
+
+              Gaia_Object object;
+
+              if (!Gaia_Object::from (line, object))
+                {
+                  invalid++;
+                  continue;
+                }
+
+              store (catalog, dest[i], object);
+            }
+
+          // A star at the Sun is worse than no catalog, so a row lacking a required column
+          // fails the load, as a parse error always did.
+          if (invalid > 0)
+            {
+              std::cerr << "ERROR: " << invalid << " row(s) of `" << path
+                        << "` lack a source_id, ra, dec, parallax or lum_flame.\n";
+              return false;
+            }
+
+          if (last)
+            break;
+
+          carry = end - stop;
+          std::memmove (buffer.data (), buffer.data () + stop, carry);
+        }
+    }
+
+  // Give back what an overestimate left unused.
+  if (catalog.bodies.capacity () > catalog.size () + catalog.size () / 8)
+    {
+      catalog.bodies.shrink_to_fit ();
+      catalog.source_ids.shrink_to_fit ();
+      catalog.epoch_positions.shrink_to_fit ();
+      catalog.velocities.shrink_to_fit ();
+      catalog.colors.shrink_to_fit ();
+      catalog.row_hashes.shrink_to_fit ();
+    }
+
+  catalog.touch ();
+
+  // Counted over the final rows, as a source_id may have been stored from several lines.
+  if (stats)
+    {
+      size_t unchanged = 0, changed = 0;
+
+      if (lookup)
+        {
+#pragma omp parallel for schedule(static) reduction(+ : unchanged, changed)
+          for (size_t i = 0; i < catalog.size (); ++i)
+            {
+              const uint32_t row = lookup->find (catalog.source_ids[i]);
+
+              if (row == Row_Lookup::NONE)
+                continue;
+
+              if (base->row_hashes[row] == catalog.row_hashes[i])
+                unchanged++;
+              else
+                changed++;
+            }
+        }
+
+      stats->unchanged = unchanged;
+      stats->changed = changed;
+      stats->added = catalog.size () - unchanged - changed;
+      stats->removed = base->size () - unchanged - changed;
+    }
+
+  return true;
+}
+} // namespace
+
+bool
+load_gaia (const std::vector<std::string> &paths, Catalog &catalog)
+{
+  const bool ok = ingest (paths, catalog);
+
+  // Hand the freed chunk buffers and dedup tables back to the system rather than keeping them
+  // in the heap for the lifetime of the program.
+  malloc_trim (0);
+
+  return ok;
+}
+
+bool
+reload_gaia (const std::vector<std::string> &paths, const Catalog &base, Catalog &catalog,
+             Reload_Stats &stats)
+{
+  const bool ok = ingest (paths, catalog, &base, &stats);
+
+  malloc_trim (0);
+
+  return ok;
+}
+
+std::vector<uint32_t>
+rows_of (const Catalog &catalog, const std::vector<int64_t> &source_ids)
+{
+  std::vector<uint32_t> rows (source_ids.size (), UINT32_MAX);
+
+  if (source_ids.empty ())
+    return rows;
+
+  std::vector<std::pair<int64_t, uint32_t>> ids;
+
+  for (size_t i = 0; i < source_ids.size (); ++i)
+    ids.push_back ({ source_ids[i], static_cast<uint32_t> (i) });
+
+  std::sort (ids.begin (), ids.end ());
+
+  // Every row binary-searches the few ids, rather than the ids the many rows.
+#pragma omp parallel for schedule(static)
+  for (size_t row = 0; row < catalog.size (); ++row)
+    {
+      const int64_t source_id = catalog.source_ids[row];
+
+      auto it = std::lower_bound (ids.begin (), ids.end (), std::make_pair (source_id, 0u));
+
+      for (; it != ids.end () && it->first == source_id; ++it)
+        rows[it->second] = static_cast<uint32_t> (row);
+    }
+
+  return rows;
+}
+
+Memory_Usage
+Memory_Usage::current ()
+{
+  Memory_Usage usage{ 0, 0 };
+
+  std::ifstream status ("/proc/self/status");
+  std::string line;
+
+  while (std::getline (status, line))
+    {
+      if (line.compare (0, 6, "VmRSS:") == 0)
+        usage.resident = std::strtoull (line.c_str () + 6, nullptr, 10) * 1024;
+      else if (line.compare (0, 6, "VmHWM:") == 0)
+        usage.peak = std::strtoull (line.c_str () + 6, nullptr, 10) * 1024;
+    }
+
+  return usage;
+}
+
+bool
+load_catalog (const std::string &path, Catalog &catalog)
+{
+  return load_catalog (std::vector<std::string>{ path }, catalog);
+}
+
+bool
+load_catalog (const std::vector<std::string> &paths, Catalog &catalog)
+{
+  if (paths.size () == 1 && is_packed (paths[0]))
+    return load_packed (paths[0], catalog);
+
+  for (const auto &path : paths)
+    if (is_packed (path))
+      {
+        std::cerr << "ERROR: packed catalog `" << path << "` cannot be merged.\n";
+        return false;
+      }
+
+  return load_gaia (paths, catalog);
+}
+
+bool
+reload_catalog (const std::vector<std::string> &paths, const Catalog &base, Catalog &catalog,
+                Reload_Stats &stats)
+{
+  for (const auto &path : paths)
+    if (is_packed (path))
+      {
+        if (!load_catalog (paths, catalog))
+          return false;
+
+        stats = { 0, 0, catalog.size (), base.size () };
+        return true;
+      }
+
+  return reload_gaia (paths, base, catalog, stats);
+}
@@ -0,0 +1,134 @@
+#ifndef CATALOG_HPP
+#define CATALOG_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "tachyon.hpp"
+
+namespace t = tachyon;
+
+struct Gaia_Object
+{
+  int64_t source_id;
+  double ra;
+  double dec;
+  double parallax;
+  double lum_flame;
+
+  // Proper motion in mas/yr and radial velocity in km/s; zero when the row lacks them.
+  double pmra;
+  double pmdec;
+  double radial_velocity;
+
+  // Photometric colour and effective temperature (K); NaN when the row lacks them.
+  double bp_rp;
+  double teff_gspphot;
+
+  Gaia_Object () = default;
+
+  // Parses one CSV row, stopping at the end of the line; false when source_id, ra, dec, parallax
+  // or lum_flame is empty or not a number.
+  static bool from (const char *line, Gaia_Object &object);
+};
+
+struct Body
+{
+  t::vector3su position;
+
+  double luminosity;
+
+  Body () = default;
+
+  Body (Gaia_Object object);
+};
+
+typedef t::vector3<float> vector3v;
+
+// Cartesian space velocity in Mm per Julian year, in the same frame as Body::position.
+vector3v velocity_of (const Gaia_Object &object);
+
+// Palette index for the object's colour, preferring teff_gspphot over BP-RP.
+uint8_t color_of (const Gaia_Object &object);
+
+// Column store of the loaded stars. Every column is indexed the same way as bodies, so reordering
+// the catalog (see Body_Index::build) must permute all of them together.
+struct Catalog
+{
+  // Gaia DR3 reference epoch, J2016.0.
+  static constexpr double EPOCH_JD = 2457389.0;
+
+  std::vector<Body> bodies;
+  std::vector<int64_t> source_ids;
+
+  // Positions at the catalog epoch and linear space velocities; bodies[i].position is derived
+  // from them by propagate().
+  std::vector<t::vector3su> epoch_positions;
+  std::vector<vector3v> velocities;
+
+  // Index into star_palette ().
+  std::vector<uint8_t> colors;
+
+  // Hash of the CSV line each row was read from, kept only by reload_gaia() so the next reload can
+  // tell which rows changed; empty otherwise.
+  std::vector<uint64_t> row_hashes;
+
+  // Years after the catalog epoch that bodies[].position currently reflects.
+  double epoch{ 0.0 };
+
+  // Process-wide unique stamp of the current body positions, renewed by loading and propagate(),
+  // so data derived from them can tell when it is stale.
+  uint64_t revision{ 0 };
+
+  size_t size () const;
+
+  void touch ();
+
+  // Moves every body to `years` after the catalog epoch. Does nothing if already there.
+  void propagate (double years);
+};
+
+// Streams Gaia CSV files straight into the catalog columns, pre-sized from the file sizes, keeping
+// one row per source_id; when a source_id appears more than once the row read last wins, so later
+// files override earlier ones.
+bool load_gaia (const std::vector<std::string> &paths, Catalog &catalog);
+
+// How a reload compares with the catalog it replaces, by source_id.
+struct Reload_Stats
+{
+  size_t unchanged, changed, added, removed;
+};
+
+// Like load_gaia(), but keeps Catalog::row_hashes, and rows whose source_id and CSV line are the
+// same as in `base` are copied from there instead of being parsed. `base` is only read, from its
+// columns other than body positions, so it may be propagated meanwhile; when it has no row hashes
+// (an empty catalog, say) every row is parsed.
+bool reload_gaia (const std::vector<std::string> &paths, const Catalog &base, Catalog &catalog,
+                  Reload_Stats &stats);
+
+bool load_catalog (const std::string &path, Catalog &catalog);
+
+// Packed catalogs load on their own only; several paths must all be CSV.
+bool load_catalog (const std::vector<std::string> &paths, Catalog &catalog);
+
+// load_catalog() through reload_gaia(), so the result can itself be reloaded incrementally. A
+// packed catalog is loaded in full and counted as all new.
+bool reload_catalog (const std::vector<std::string> &paths, const Catalog &base, Catalog &catalog,
+                     Reload_Stats &stats);
+
+// Catalog row of each of `source_ids`, or UINT32_MAX for those the catalog lacks. A pass over the
+// whole catalog, so a reload runs it off the render thread (see Catalog_Watcher).
+std::vector<uint32_t> rows_of (const Catalog &catalog,
+                               const std::vector<int64_t> &source_ids);
+
+// Resident set size of the process now and at its peak, in bytes; zero without /proc.
+struct Memory_Usage
+{
+  size_t resident;
+  size_t peak;
+
+  static Memory_Usage current ();
+};
+
+#endif // CATALOG_HPP
@@ -0,0 +1,11 @@
+#ifndef COMMON_HPP
+#define COMMON_HPP
+
+static constexpr auto PI = 3.1415927;
+static constexpr auto PI_2 = PI / 2;
+static constexpr auto TAU = PI * 2;
+
+#define RAD(a) ((a) * (PI / 180.0f))
+#define DEG(a) ((a) / (PI / 180.0f))
+
+#endif // COMMON_HPP
@@ -0,0 +1,240 @@
+#include "density.hpp"
+#include "common.hpp"
+#include "tachyon_frame.hpp"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Galactic Cartesian coordinates in Mm, unrounded, as the binning wants them.
+void
+to_galactic (const t::vector3su &p, double g[3])
+{
+  const double x = p.x.as_Mm (), y = p.y.as_Mm (), z = p.z.as_Mm ();
+  const auto &m = t::ICRS_TO_GALACTIC.m;
+
+  for (int a = 0; a < 3; ++a)
+    g[a] = m[a][0] * x + m[a][1] * y + m[a][2] * z;
+}
+
+// atan2 to about 1e-5 rad, far below a cell, without the libm call in the binning loop.
+double
+fast_atan2 (double y, double x)
+{
+  const double ax = std::fabs (x), ay = std::fabs (y);
+
+  const double lo = std::min (ax, ay), hi = std::max (ax, ay);
+
+  if (hi == 0.0)
+    return 0.0;
+
+  const double a = lo / hi;
+  const double s = a * a;
+
+  double r = ((((-0.0117212 * s + 0.05265332) * s - 0.11643287) * s + 0.19354346) * s
+              - 0.33262347)
+                 * s
+             + 0.99997726;
+
+  r *= a;
+
+  if (ay > ax)
+    r = PI_2 - r;
+
+  if (x < 0.0)
+    r = PI - r;
+
+  return y < 0.0 ? -r : r;
+}
+
+// Fractional cell of galactic coordinates `g` for the map's projection; false outside the grid.
+bool
+cell_of (const Density_Map &map, const double g[3], double &u, double &v)
+{
+  if (map.view == DENSITY_PLANE)
+    {
+      const double scale = map.height / static_cast<double> (map.extent.as_Mm ());
+
+      u = map.width / 2.0 - g[1] * scale;
+      v = map.height / 2.0 - g[0] * scale;
+    }
+  else
+    {
+      const double r = std::sqrt (g[0] * g[0] + g[1] * g[1] + g[2] * g[2]);
+
+      if (r == 0.0)
+        return false;
+
+      u = (0.5 - fast_atan2 (g[1], g[0]) / TAU) * map.width;
+      v = (0.5 - 0.5 * g[2] / r) * map.height;
+    }
+
+  return u >= 0.0 && v >= 0.0 && u < map.width && v < map.height;
+}
+
+struct Ramp_Stop
+{
+  float t;
+  uint8_t r, g, b;
+};
+
+const Ramp_Stop RAMP[] = {
+  { 0.00f, 0, 0, 4 },      { 0.25f, 60, 9, 100 },    { 0.50f, 170, 50, 90 },
+  { 0.75f, 245, 125, 20 }, { 1.00f, 252, 255, 164 },
+};
+
+// Decades of luminosity below the brightest cell that the ramp spans.
+constexpr double LUMINOSITY_DECADES = 6.0;
+} // namespace
+
+Density_Map::Density_Map (Density_View _view, uint32_t _width, uint32_t _height,
+                          t::spatial_unit _extent)
+    : view (_view), width (_width), height (_height), extent (_extent)
+{
+}
+
+bool
+Density_Map::locate (const t::vector3su &position, double &u, double &v) const
+{
+  double g[3];
+
+  to_galactic (position, g);
+
+  return cell_of (*this, g, u, v);
+}
+
+void
+Density_Map::build (const Catalog &catalog)
+{
+  const size_t cells = static_cast<size_t> (width) * height;
+  const size_t n = catalog.size ();
+
+  std::vector<std::vector<uint32_t>> thread_counts (omp_get_max_threads ());
+  std::vector<std::vector<float>> thread_luminosity (thread_counts.size ());
+
+  counts.assign (cells, 0);
+  luminosity.assign (cells, 0.0f);
+
+  int threads = 1;
+
+#pragma omp parallel
+  {
+    const int id = omp_get_thread_num ();
+
+#pragma omp single
+    threads = omp_get_num_threads ();
+
+    auto &c = thread_counts[id];
+    auto &l = thread_luminosity[id];
+
+    c.assign (cells, 0);
+    l.assign (cells, 0.0f);
+
+#pragma omp for schedule(static)
+    for (size_t i = 0; i < n; ++i)
+      {
+        const Body &body = catalog.bodies[i];
+
+        double g[3], u, v;
+
+        to_galactic (body.position, g);
+
+        if (!cell_of (*this, g, u, v))
+          continue;
+
+        const size_t cell = static_cast<size_t> (v) * width + static_cast<size_t> (u);
+
+        c[cell]++;
+        l[cell] += body.luminosity;
+      }
+
+#pragma omp for schedule(static)
+    for (size_t cell = 0; cell < cells; ++cell)
+      for (int t = 0; t < threads; ++t)
+        {
+          counts[cell] += thread_counts[t][cell];
+          luminosity[cell] += thread_luminosity[t][cell];
+        }
+  }
+
+  max_count = *std::max_element (counts.begin (), counts.end ());
+  max_luminosity = *std::max_element (luminosity.begin (), luminosity.end ());
+
+  revision = catalog.revision;
+}
+
+void
+Density_Map::colorize (bool by_luminosity, std::vector<uint8_t> &rgba) const
+{
+  const size_t cells = counts.size ();
+
+  rgba.resize (4 * cells);
+
+  const double log_count = std::log1p (static_cast<double> (max_count));
+  const double log_luminosity = std::log10 (std::max (max_luminosity, 1e-30f));
+
+#pragma omp parallel for schedule(static)
+  for (size_t cell = 0; cell < cells; ++cell)
+    {
+      double x = 0.0;
+
+      if (!by_luminosity)
+        x = max_count > 0 ? std::log1p (static_cast<double> (counts[cell])) / log_count : 0.0;
+      else if (luminosity[cell] > 0.0f)
+        x = 1.0 + (std::log10 (luminosity[cell]) - log_luminosity) / LUMINOSITY_DECADES;
+
+      const float f = std::clamp (x, 0.0, 1.0);
+
+      size_t k = 1;
+
+      while (k + 1 < std::size (RAMP) && RAMP[k].t < f)
+        ++k;
+
+      const Ramp_Stop &a = RAMP[k - 1], &b = RAMP[k];
+
+      const float w = (f - a.t) / (b.t - a.t);
+
+      uint8_t *out = &rgba[4 * cell];
+
+      out[0] = a.r + (b.r - a.r) * w;
+      out[1] = a.g + (b.g - a.g) * w;
+      out[2] = a.b + (b.b - a.b) * w;
+      out[3] = 255;
+    }
+}
+
+const Density_Map &
+Density_Cache::get (const Catalog &catalog, Density_View view, uint32_t width, uint32_t height,
+                    t::spatial_unit extent)
+{
+  auto it = std::find_if (maps.begin (), maps.end (), [&] (const auto &map) {
+    return map->view == view && map->width == width && map->height == height
+           && (view == DENSITY_SKY || map->extent == extent);
+  });
+
+  std::unique_ptr<Density_Map> map;
+
+  if (it != maps.end ())
+    {
+      map = std::move (*it);
+      maps.erase (it);
+    }
+  else
+    {
+      map = std::make_unique<Density_Map> (view, width, height, extent);
+
+      if (maps.size () >= CAPACITY)
+        maps.pop_back ();
+    }
+
+  if (map->counts.empty () || map->revision != catalog.revision)
+    map->build (catalog);
+
+  // Most recently used first.
+  maps.insert (maps.begin (), std::move (map));
+
+  return *maps.front ();
+}
@@ -0,0 +1,62 @@
+#ifndef DENSITY_HPP
+#define DENSITY_HPP
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "catalog.hpp"
+
+enum Density_View
+{
+  DENSITY_PLANE,
+  DENSITY_SKY
+};
+
+// Star counts and summed luminosity binned on a grid of cells, in galactic coordinates.
+//
+// DENSITY_PLANE looks down on the galactic plane from the north galactic pole, centred on the Sun
+// with the Galactic Centre up; `extent` is the span of the grid's height. DENSITY_SKY is the whole
+// sky as seen from the Sun, galactic longitude across (0° in the middle, increasing to the left)
+// and sin(latitude) up: a cylindrical equal-area projection, so every cell covers the same solid
+// angle.
+struct Density_Map
+{
+  Density_View view;
+  uint32_t width, height;
+  t::spatial_unit extent;
+
+  // Catalog::revision the cells were binned from.
+  uint64_t revision{ 0 };
+
+  std::vector<uint32_t> counts;
+  std::vector<float> luminosity;
+
+  uint32_t max_count{ 0 };
+  float max_luminosity{ 0.0f };
+
+  Density_Map (Density_View _view, uint32_t _width, uint32_t _height, t::spatial_unit _extent);
+
+  // Cell of a position, in fractional cell units; false when it falls outside the grid.
+  bool locate (const t::vector3su &position, double &u, double &v) const;
+
+  // Every thread bins into its own grid; the grids are then summed in parallel by cell.
+  void build (const Catalog &catalog);
+
+  // Log-scaled colour ramp of counts or luminosity, as RGBA rows from the top.
+  void colorize (bool by_luminosity, std::vector<uint8_t> &rgba) const;
+};
+
+// Maps by view, resolution and extent, rebuilt only when the catalog's revision moves on. The
+// least recently used one is dropped once there are more than CAPACITY.
+struct Density_Cache
+{
+  static constexpr size_t CAPACITY = 8;
+
+  std::vector<std::unique_ptr<Density_Map>> maps;
+
+  const Density_Map &get (const Catalog &catalog, Density_View view, uint32_t width,
+                          uint32_t height, t::spatial_unit extent);
+};
+
+#endif // DENSITY_HPP
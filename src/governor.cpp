@@ -0,0 +1,150 @@
+#include "governor.hpp"
+
+#include <algorithm>
+
+namespace
+{
+constexpr double STAR_LOD[Quality_Governor::STAR_LEVELS] = { 1, 2, 4, 8, 16, 32 };
+
+// Star budget as a right shift of the stars last found in view; negative means unlimited.
+constexpr int STAR_BUDGET_SHIFT[Quality_Governor::STAR_LEVELS] = { -1, -1, -1, 1, 2, 3 };
+
+constexpr double ORBIT_PIXELS[Quality_Governor::OVERLAY_LEVELS] = { 8, 16, 32, 64 };
+constexpr int OVERLAY_DETAIL[Quality_Governor::OVERLAY_LEVELS] = { 2, 2, 1, 0 };
+
+// Below this fraction of the target there is room to raise quality again.
+constexpr double HEADROOM = 0.75;
+
+// Weight of the newest frame in the smoothed times.
+constexpr double SMOOTHING = 0.1;
+} // namespace
+
+Quality_Governor::Quality_Governor (double _target_ms)
+    : target_ms (_target_ms), enabled (_target_ms > 0.0)
+{
+}
+
+void
+Quality_Governor::toggle ()
+{
+  enabled = !enabled && target_ms > 0.0;
+}
+
+void
+Quality_Governor::begin_frame ()
+{
+  last = clock::now ();
+
+  std::fill (current, current + STAGE_COUNT, 0.0);
+}
+
+void
+Quality_Governor::mark (Frame_Stage stage)
+{
+  const auto now = clock::now ();
+
+  current[stage] += std::chrono::duration<double, std::milli> (now - last).count ();
+  last = now;
+}
+
+void
+Quality_Governor::end_frame ()
+{
+  double total = 0.0;
+
+  for (int s = 0; s < STAGE_COUNT; ++s)
+    {
+      stage_ms[s] += (current[s] - stage_ms[s]) * SMOOTHING;
+      total += current[s];
+    }
+
+  frame_ms += (total - frame_ms) * SMOOTHING;
+
+  // An upgrade that held through probation earns back some of the backoff.
+  if (++since_upgrade == UPGRADE_PROBATION)
+    upgrade_delay = std::max (upgrade_delay / 2, UPGRADE_DELAY_MIN);
+
+  if (!enabled)
+    {
+      star_level = overlay_level = 0;
+      return;
+    }
+
+  if (cooldown > 0)
+    {
+      cooldown--;
+      return;
+    }
+
+  if (frame_ms > target_ms)
+    {
+      const bool stars_first = stage_ms[STAGE_STARS] >= stage_ms[STAGE_OVERLAY];
+
+      if (stars_first && star_level + 1 < STAR_LEVELS)
+        star_level++;
+      else if (overlay_level + 1 < OVERLAY_LEVELS)
+        overlay_level++;
+      else if (star_level + 1 < STAR_LEVELS)
+        star_level++;
+      else
+        return;
+
+      if (since_upgrade < UPGRADE_PROBATION)
+        upgrade_delay = std::min (2 * upgrade_delay, UPGRADE_DELAY_MAX);
+
+      cooldown = DEGRADE_DELAY;
+    }
+  else if (frame_ms < target_ms * HEADROOM && (star_level > 0 || overlay_level > 0))
+    {
+      // Raise whichever ladder is further down; overlays first on a tie since they are cheaper.
+      if (overlay_level >= star_level)
+        overlay_level--;
+      else
+        star_level--;
+
+      // Probation starts once the cooldown is over and the governor could react again.
+      since_upgrade = -upgrade_delay;
+      cooldown = upgrade_delay;
+    }
+}
+
+Quality
+Quality_Governor::quality (size_t visible) const
+{
+  const int shift = STAR_BUDGET_SHIFT[star_level];
+
+  return { STAR_LOD[star_level], shift < 0 ? 0 : std::max<size_t> (visible >> shift, 1),
+           ORBIT_PIXELS[overlay_level], OVERLAY_DETAIL[overlay_level] };
+}
+
+size_t
+limit_ranges (std::vector<Body_Index::Range> &ranges, size_t budget)
+{
+  if (budget == 0)
+    return 0;
+
+  size_t kept = 0, dropped = 0;
+  size_t r = ranges.size ();
+
+  while (r > 0 && kept < budget)
+    {
+      auto &range = ranges[--r];
+
+      const size_t n = range.end - range.begin;
+
+      if (kept + n > budget)
+        {
+          range.begin = range.end - (budget - kept);
+          dropped += n - (budget - kept);
+        }
+
+      kept += range.end - range.begin;
+    }
+
+  for (size_t i = 0; i < r; ++i)
+    dropped += ranges[i].end - ranges[i].begin;
+
+  ranges.erase (ranges.begin (), ranges.begin () + r);
+
+  return dropped;
+}
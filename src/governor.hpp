@@ -0,0 +1,92 @@
+#ifndef GOVERNOR_HPP
+#define GOVERNOR_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+#include "index.hpp"
+
+enum Frame_Stage
+{
+  STAGE_UPDATE,
+  STAGE_STARS,
+  STAGE_OVERLAY,
+  STAGE_HUD,
+  STAGE_COUNT
+};
+
+// Knobs the governor turns; level 0 of both ladders is full quality.
+struct Quality
+{
+  // Multiplier on Exposure::flux_cutoff(); 1 culls only stars that would be invisible.
+  double lod_scale;
+
+  // Most stars shaded per frame, zero for no limit.
+  size_t star_budget;
+
+  // Screen length of one orbit segment, in pixels.
+  double orbit_pixels;
+
+  // 2 draws solar system markers with names, 1 without names, 0 not at all.
+  int overlay;
+};
+
+// Holds the CPU time of a frame near a target by stepping two quality ladders: one for the star
+// pass and one for orbits and markers. Whichever stage costs more is degraded first when over
+// budget; recovery only starts once the frame is well under budget and, after an upgrade had to
+// be reverted, waits progressively longer, so quality doesn't oscillate around the target.
+struct Quality_Governor
+{
+  static constexpr int STAR_LEVELS = 6;
+  static constexpr int OVERLAY_LEVELS = 4;
+
+  double target_ms;
+  bool enabled{ true };
+
+  int star_level{ 0 };
+  int overlay_level{ 0 };
+
+  // Smoothed per-stage and total frame times.
+  double stage_ms[STAGE_COUNT]{};
+  double frame_ms{ 0.0 };
+
+  Quality_Governor (double _target_ms);
+
+  // Turns the governor on or off; without a target (zero) it stays off.
+  void toggle ();
+
+  void begin_frame ();
+
+  // Charges the time since the previous mark (or begin_frame) to `stage`.
+  void mark (Frame_Stage stage);
+
+  void end_frame ();
+
+  // `visible` is how many stars the last frame found in view before any budget, so every step of
+  // the budget cuts what is actually shaded rather than a share of the whole catalog.
+  Quality quality (size_t visible) const;
+
+  using clock = std::chrono::steady_clock;
+
+  // Per-frame bookkeeping.
+  clock::time_point last;
+  double current[STAGE_COUNT]{};
+
+  int cooldown{ 0 };
+  int upgrade_delay{ UPGRADE_DELAY_MIN };
+  int since_upgrade{ UPGRADE_PROBATION };
+
+  static constexpr int DEGRADE_DELAY = 15;
+  static constexpr int UPGRADE_DELAY_MIN = 60;
+  static constexpr int UPGRADE_DELAY_MAX = 1920;
+
+  // An upgrade reverted within this many frames doubles the wait before the next one.
+  static constexpr int UPGRADE_PROBATION = 120;
+};
+
+// Keeps the last `budget` stars of the ranges and returns how many were dropped. The index orders
+// buckets faintest first, so the brightest stars survive.
+size_t limit_ranges (std::vector<Body_Index::Range> &ranges, size_t budget);
+
+#endif // GOVERNOR_HPP
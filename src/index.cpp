@@ -0,0 +1,721 @@
+#include "index.hpp"
+#include "common.hpp"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <string>
+
+namespace
+{
+t::vector3f
+to_Mm (const t::vector3su &v)
+{
+  return t::vector3f (v.x.as_Mm (), v.y.as_Mm (), v.z.as_Mm ());
+}
+
+double
+axis (const t::vector3f &v, int a)
+{
+  return a == 0 ? v.x : a == 1 ? v.y : v.z;
+}
+
+// A cone from `o` along the unit vector `direction`, with its half-angle's sine and cosine
+// precomputed so the per-node test needs no trigonometry.
+struct Cone
+{
+  t::vector3f o, direction;
+  double half_angle, cos_half, sin_half;
+
+  Cone (const t::vector3f &_o, const t::vector3f &_direction, double _half_angle)
+      : o (_o), direction (_direction), half_angle (_half_angle),
+        cos_half (std::cos (_half_angle)), sin_half (std::sin (_half_angle))
+  {
+  }
+};
+
+// Whether a node's bounding sphere lies entirely outside the cone.
+bool
+cone_misses (const Body_Index &index, size_t node, const Cone &cone)
+{
+  const auto &n = index.nodes[node];
+
+  const auto center = (n.lo + n.hi) * 0.5 - cone.o;
+  const double radius = n.lo.distance (n.hi) * 0.5 + index.padding (node);
+  const double distance
+      = std::sqrt (center.x * center.x + center.y * center.y + center.z * center.z);
+
+  if (distance <= radius)
+    return false;
+
+  const double cos_angle = (center.x * cone.direction.x + center.y * cone.direction.y
+                            + center.z * cone.direction.z)
+                           / distance;
+
+  // The sphere subtends asin(radius / distance); it misses when the angle to its centre exceeds
+  // the half-angle plus that. Comparing cosines is only valid while the sum stays below pi.
+  if (cone.half_angle > PI_2)
+    {
+      const double angle = std::acos (std::clamp (cos_angle, -1.0, 1.0));
+
+      return angle - std::asin (radius / distance) > cone.half_angle;
+    }
+
+  const double sin_r = radius / distance;
+  const double cos_r = std::sqrt (1.0 - sin_r * sin_r);
+
+  return cos_angle < cone.cos_half * cos_r - cone.sin_half * sin_r;
+}
+
+template <typename T>
+void
+permute (std::vector<T> &column, const std::vector<uint32_t> &order)
+{
+  std::vector<T> result (column.size ());
+
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < order.size (); ++i)
+    result[i] = column[order[i]];
+
+  column.swap (result);
+}
+
+struct Item
+{
+  double p[3];
+  double luminosity;
+  float speed;
+  uint32_t index;
+};
+
+// Luminosity buckets are half a decade wide; anything outside the range shares the end buckets.
+constexpr int BUCKET_MIN = -10;
+constexpr int BUCKET_COUNT = 24;
+
+int
+luminosity_bucket (double L)
+{
+  if (!(L > 0.0))
+    return 0;
+
+  const int b = static_cast<int> (std::floor (2.0 * std::log10 (L))) - BUCKET_MIN;
+
+  return std::clamp (b, 0, BUCKET_COUNT - 1);
+}
+
+// Number of nodes build_node() produces for a range of n items.
+size_t
+subtree_size (uint32_t n)
+{
+  if (n <= Body_Index::LEAF_SIZE)
+    return 1;
+
+  return 1 + subtree_size (n / 2) + subtree_size (n - n / 2);
+}
+
+void
+build_node (std::vector<Body_Index::Node> &nodes, std::vector<Item> &items, size_t node,
+            uint32_t begin, uint32_t end)
+{
+  auto &n = nodes[node];
+
+  n.begin = begin;
+  n.end = end;
+  n.lo = t::vector3f (std::numeric_limits<double>::max ());
+  n.hi = t::vector3f (std::numeric_limits<double>::lowest ());
+  n.max_luminosity = 0.0;
+  n.max_speed = 0.0;
+  n.right = 0;
+
+  for (uint32_t i = begin; i < end; ++i)
+    {
+      const auto &item = items[i];
+
+      n.max_speed = std::max<double> (n.max_speed, item.speed);
+
+      n.lo.x = std::min (n.lo.x, item.p[0]), n.hi.x = std::max (n.hi.x, item.p[0]);
+      n.lo.y = std::min (n.lo.y, item.p[1]), n.hi.y = std::max (n.hi.y, item.p[1]);
+      n.lo.z = std::min (n.lo.z, item.p[2]), n.hi.z = std::max (n.hi.z, item.p[2]);
+
+      n.max_luminosity = std::max (n.max_luminosity, item.luminosity);
+    }
+
+  if (end - begin <= Body_Index::LEAF_SIZE)
+    return;
+
+  const auto extent = n.hi - n.lo;
+
+  int a = 0;
+
+  if (extent.y > axis (extent, a))
+    a = 1;
+  if (extent.z > axis (extent, a))
+    a = 2;
+
+  const uint32_t middle = begin + (end - begin) / 2;
+
+  std::nth_element (items.begin () + begin, items.begin () + middle, items.begin () + end,
+                    [a] (const Item &l, const Item &r) { return l.p[a] < r.p[a]; });
+
+  const size_t right = node + 1 + subtree_size (middle - begin);
+
+  n.right = right;
+
+#pragma omp task if (end - begin > 65536) shared (nodes, items)
+  build_node (nodes, items, node + 1, begin, middle);
+
+#pragma omp task if (end - begin > 65536) shared (nodes, items)
+  build_node (nodes, items, right, middle, end);
+
+#pragma omp taskwait
+}
+
+struct Sphere_Region
+{
+  t::vector3f center;
+  double radius;
+
+  bool
+  contains (const t::vector3f &p) const
+  {
+    const auto d = p - center;
+    return d.x * d.x + d.y * d.y + d.z * d.z <= radius * radius;
+  }
+
+  bool
+  intersects (const Body_Index &index, size_t node) const
+  {
+    return index.min_distance (node, center) <= radius;
+  }
+
+  bool
+  encloses (const Body_Index &index, size_t node) const
+  {
+    const auto &n = index.nodes[node];
+
+    const double pad = index.padding (node);
+
+    const double dx = std::max (center.x - n.lo.x, n.hi.x - center.x) + pad;
+    const double dy = std::max (center.y - n.lo.y, n.hi.y - center.y) + pad;
+    const double dz = std::max (center.z - n.lo.z, n.hi.z - center.z) + pad;
+
+    return dx * dx + dy * dy + dz * dz <= radius * radius;
+  }
+};
+
+struct Box_Region
+{
+  t::vector3f lo, hi;
+
+  bool
+  contains (const t::vector3f &p) const
+  {
+    return p.x >= lo.x && p.x <= hi.x && p.y >= lo.y && p.y <= hi.y && p.z >= lo.z
+           && p.z <= hi.z;
+  }
+
+  bool
+  intersects (const Body_Index &index, size_t node) const
+  {
+    const auto &n = index.nodes[node];
+    const double pad = index.padding (node);
+
+    return n.lo.x - pad <= hi.x && n.hi.x + pad >= lo.x && n.lo.y - pad <= hi.y
+           && n.hi.y + pad >= lo.y && n.lo.z - pad <= hi.z && n.hi.z + pad >= lo.z;
+  }
+
+  bool
+  encloses (const Body_Index &index, size_t node) const
+  {
+    const auto &n = index.nodes[node];
+    const double pad = index.padding (node);
+
+    return contains (n.lo - t::vector3f (pad)) && contains (n.hi + t::vector3f (pad));
+  }
+};
+
+template <typename Region>
+Query_Stats
+query_region (const Body_Index &index, const Catalog &catalog, const Region &region,
+              Query_Sink *sink)
+{
+  static constexpr size_t CHUNK = 4096;
+
+  Query_Stats stats{ 0, 0.0, 0.0 };
+
+  // Expand breadth-first until there is enough independent work for every thread.
+  std::vector<size_t> frontier;
+  std::vector<size_t> next;
+
+  for (size_t root : index.roots)
+    if (region.intersects (index, root))
+      frontier.push_back (root);
+
+  if (frontier.empty ())
+    return stats;
+
+  const size_t target = 16 * static_cast<size_t> (omp_get_max_threads ());
+
+  while (frontier.size () < target)
+    {
+      next.clear ();
+
+      bool expanded = false;
+
+      for (size_t node : frontier)
+        {
+          if (index.is_leaf (node) || region.encloses (index, node))
+            {
+              next.push_back (node);
+              continue;
+            }
+
+          for (size_t child : { index.left (node), index.right (node) })
+            if (region.intersects (index, child))
+              next.push_back (child);
+
+          expanded = true;
+        }
+
+      frontier.swap (next);
+
+      if (!expanded)
+        break;
+    }
+
+  uint64_t count = 0;
+  double luminosity_sum = 0.0;
+  double luminosity_max = 0.0;
+
+#pragma omp parallel reduction(+ : count, luminosity_sum) reduction(max : luminosity_max)
+  {
+    std::vector<uint32_t> chunk;
+    std::vector<size_t> stack;
+
+    chunk.reserve (CHUNK);
+
+    auto emit = [&] (uint32_t i) {
+      const double L = catalog.bodies[i].luminosity;
+
+      count++;
+      luminosity_sum += L;
+      luminosity_max = std::max (luminosity_max, L);
+
+      if (sink)
+        {
+          chunk.push_back (i);
+
+          if (chunk.size () == CHUNK)
+            {
+              sink->write (catalog, chunk.data (), chunk.size ());
+              chunk.clear ();
+            }
+        }
+    };
+
+#pragma omp for schedule(dynamic)
+    for (size_t f = 0; f < frontier.size (); ++f)
+      {
+        stack.assign (1, frontier[f]);
+
+        while (!stack.empty ())
+          {
+            const size_t node = stack.back ();
+            stack.pop_back ();
+
+            const auto &n = index.nodes[node];
+
+            if (region.encloses (index, node))
+              {
+                for (uint32_t i = n.begin; i < n.end; ++i)
+                  emit (i);
+              }
+            else if (index.is_leaf (node))
+              {
+                for (uint32_t i = n.begin; i < n.end; ++i)
+                  if (region.contains (to_Mm (catalog.bodies[i].position)))
+                    emit (i);
+              }
+            else
+              {
+                for (size_t child : { index.left (node), index.right (node) })
+                  if (region.intersects (index, child))
+                    stack.push_back (child);
+              }
+          }
+      }
+
+    if (sink && !chunk.empty ())
+      sink->write (catalog, chunk.data (), chunk.size ());
+  }
+
+  stats.count = count;
+  stats.luminosity_sum = luminosity_sum;
+  stats.luminosity_max = luminosity_max;
+
+  return stats;
+}
+} // namespace
+
+Query_Csv_Sink::Query_Csv_Sink (std::ostream &_out) : out (_out) {}
+
+void
+Query_Csv_Sink::write (const Catalog &catalog, const uint32_t *indices, size_t n)
+{
+  std::string buffer;
+  char line[160];
+
+  buffer.reserve (n * 80);
+
+  for (size_t k = 0; k < n; ++k)
+    {
+      const auto i = indices[k];
+      const auto &body = catalog.bodies[i];
+
+      const int length = snprintf (line, sizeof line, "%ld,%.6f,%.6f,%.6f,%.6g\n",
+                                   catalog.source_ids[i], body.position.x.as_pc (),
+                                   body.position.y.as_pc (), body.position.z.as_pc (),
+                                   body.luminosity);
+
+      buffer.append (line, length);
+    }
+
+  std::lock_guard<std::mutex> lock (mutex);
+
+  out.write (buffer.data (), buffer.size ());
+}
+
+Query_Binary_Sink::Query_Binary_Sink (std::ostream &_out) : out (_out) {}
+
+void
+Query_Binary_Sink::write (const Catalog &catalog, const uint32_t *indices, size_t n)
+{
+  struct Record
+  {
+    int64_t source_id;
+    double x, y, z;
+    double luminosity;
+  };
+
+  std::vector<Record> records (n);
+
+  for (size_t k = 0; k < n; ++k)
+    {
+      const auto i = indices[k];
+      const auto &body = catalog.bodies[i];
+
+      records[k] = { catalog.source_ids[i], body.position.x.as_pc (), body.position.y.as_pc (),
+                     body.position.z.as_pc (), body.luminosity };
+    }
+
+  std::lock_guard<std::mutex> lock (mutex);
+
+  out.write (reinterpret_cast<const char *> (records.data ()), n * sizeof (Record));
+}
+
+void
+Body_Index::build (Catalog &catalog)
+{
+  const uint32_t n = catalog.size ();
+
+  nodes.clear ();
+  roots.clear ();
+
+  if (n == 0)
+    return;
+
+  std::vector<Item> items (n);
+  std::vector<uint8_t> buckets (n);
+
+#pragma omp parallel for schedule(static)
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      const auto p = to_Mm (catalog.bodies[i].position);
+
+      const auto &v = catalog.velocities[i];
+
+      buckets[i] = luminosity_bucket (catalog.bodies[i].luminosity);
+      items[i] = { { p.x, p.y, p.z },
+                   catalog.bodies[i].luminosity,
+                   std::sqrt (v.x * v.x + v.y * v.y + v.z * v.z),
+                   i };
+    }
+
+  // Counting sort by bucket, so every bucket owns a contiguous range of the catalog.
+  uint32_t starts[BUCKET_COUNT + 1] = {};
+
+  for (uint32_t i = 0; i < n; ++i)
+    starts[buckets[i] + 1]++;
+
+  for (int b = 0; b < BUCKET_COUNT; ++b)
+    starts[b + 1] += starts[b];
+
+  {
+    std::vector<Item> sorted (n);
+    uint32_t cursor[BUCKET_COUNT];
+
+    std::copy (starts, starts + BUCKET_COUNT, cursor);
+
+    for (uint32_t i = 0; i < n; ++i)
+      sorted[cursor[buckets[i]]++] = items[i];
+
+    items.swap (sorted);
+  }
+
+  std::vector<uint8_t> ().swap (buckets);
+
+  // Node layout is fixed by the range sizes, so every tree knows its offset before building.
+  size_t total = 0;
+
+  for (int b = 0; b < BUCKET_COUNT; ++b)
+    if (starts[b] < starts[b + 1])
+      {
+        roots.push_back (total);
+        total += subtree_size (starts[b + 1] - starts[b]);
+      }
+
+  nodes.assign (total, Node{});
+
+#pragma omp parallel
+#pragma omp single
+  {
+    size_t root = 0;
+
+    for (int b = 0; b < BUCKET_COUNT; ++b)
+      if (starts[b] < starts[b + 1])
+        {
+#pragma omp task shared (nodes, items)
+          build_node (nodes, items, roots[root], starts[b], starts[b + 1]);
+
+          root++;
+        }
+  }
+
+  std::vector<uint32_t> order (n);
+
+#pragma omp parallel for schedule(static)
+  for (uint32_t i = 0; i < n; ++i)
+    order[i] = items[i].index;
+
+  std::vector<Item> ().swap (items);
+
+  permute (catalog.bodies, order);
+  permute (catalog.source_ids, order);
+  permute (catalog.epoch_positions, order);
+  permute (catalog.velocities, order);
+  permute (catalog.colors, order);
+
+  if (!catalog.row_hashes.empty ())
+    permute (catalog.row_hashes, order);
+
+  built_epoch = catalog.epoch;
+  drift = 0.0;
+}
+
+void
+Body_Index::set_epoch (double epoch)
+{
+  drift = std::abs (epoch - built_epoch);
+}
+
+bool
+Body_Index::empty () const
+{
+  return roots.empty ();
+}
+
+bool
+Body_Index::is_leaf (size_t node) const
+{
+  return nodes[node].end - nodes[node].begin <= LEAF_SIZE;
+}
+
+size_t
+Body_Index::left (size_t node) const
+{
+  return node + 1;
+}
+
+size_t
+Body_Index::right (size_t node) const
+{
+  return nodes[node].right;
+}
+
+double
+Body_Index::padding (size_t node) const
+{
+  return nodes[node].max_speed * drift;
+}
+
+double
+Body_Index::min_distance (size_t node, const t::vector3f &point) const
+{
+  const auto &n = nodes[node];
+
+  const double dx = std::max ({ n.lo.x - point.x, 0.0, point.x - n.hi.x });
+  const double dy = std::max ({ n.lo.y - point.y, 0.0, point.y - n.hi.y });
+  const double dz = std::max ({ n.lo.z - point.z, 0.0, point.z - n.hi.z });
+
+  return std::max (std::sqrt (dx * dx + dy * dy + dz * dz) - padding (node), 0.0);
+}
+
+Body_Index::Pick
+Body_Index::pick (const Catalog &catalog, const t::vector3su &origin,
+                  const t::vector3f &direction, double tolerance) const
+{
+  Pick best{ false, 0, 0.0 };
+
+  if (empty ())
+    return best;
+
+  const auto o = to_Mm (origin);
+  const double cos_tolerance = std::cos (tolerance);
+  const Cone cone (o, direction, tolerance);
+
+  double best_flux = 0.0;
+
+  // Best-first on an upper bound of the apparent flux a node can contribute.
+  using Entry = std::pair<double, size_t>;
+  std::priority_queue<Entry> queue;
+
+  for (size_t root : roots)
+    queue.push ({ std::numeric_limits<double>::infinity (), root });
+
+  while (!queue.empty ())
+    {
+      const auto [bound, node] = queue.top ();
+      queue.pop ();
+
+      if (best.found && bound <= best_flux)
+        break;
+
+      const auto &n = nodes[node];
+
+      if (is_leaf (node))
+        {
+          for (uint32_t i = n.begin; i < n.end; ++i)
+            {
+              const auto &body = catalog.bodies[i];
+              const auto v = to_Mm (body.position) - o;
+
+              const double d2 = v.x * v.x + v.y * v.y + v.z * v.z;
+              const double dot = v.x * direction.x + v.y * direction.y + v.z * direction.z;
+
+              if (d2 == 0.0 || dot <= 0.0 || dot * dot < cos_tolerance * cos_tolerance * d2)
+                continue;
+
+              const double flux = body.luminosity / d2;
+
+              if (!best.found || flux > best_flux)
+                {
+                  best = { true, i, std::acos (std::min (dot / std::sqrt (d2), 1.0)) };
+                  best_flux = flux;
+                }
+            }
+
+          continue;
+        }
+
+      for (size_t child : { left (node), right (node) })
+        {
+          const auto &c = nodes[child];
+
+          if (cone_misses (*this, child, cone))
+            continue;
+
+          const double d = min_distance (child, o);
+          const double child_bound = d > 0.0 ? c.max_luminosity / (d * d)
+                                             : std::numeric_limits<double>::infinity ();
+
+          if (!best.found || child_bound > best_flux)
+            queue.push ({ child_bound, child });
+        }
+    }
+
+  return best;
+}
+
+Query_Stats
+Body_Index::query (const Catalog &catalog, const Query_Sphere &sphere, Query_Sink *sink) const
+{
+  const Sphere_Region region{ to_Mm (sphere.center),
+                              static_cast<double> (sphere.radius.as_Mm ()) };
+
+  return query_region (*this, catalog, region, sink);
+}
+
+Query_Stats
+Body_Index::query (const Catalog &catalog, const Query_Box &box, Query_Sink *sink) const
+{
+  const Box_Region region{ to_Mm (box.lo), to_Mm (box.hi) };
+
+  return query_region (*this, catalog, region, sink);
+}
+
+void
+Body_Index::cone (const t::vector3su &origin, const t::vector3f &direction, double half_angle,
+                  std::vector<Range> &ranges) const
+{
+  visible (origin, direction, half_angle, 0.0, ranges);
+}
+
+void
+Body_Index::visible (const t::vector3su &origin, const t::vector3f &direction, double half_angle,
+                     double flux_min, std::vector<Range> &ranges, uint64_t *culled) const
+{
+  ranges.clear ();
+
+  if (culled)
+    *culled = 0;
+
+  const auto o = to_Mm (origin);
+  const Cone cone (o, direction, half_angle);
+
+  // Flux is compared in L☉ / AU², distances come out of the tree in Mm.
+  const double AU = t::spatial_unit::AU;
+  const double cutoff = flux_min / (AU * AU);
+
+  std::vector<size_t> stack (roots.rbegin (), roots.rend ());
+
+  while (!stack.empty ())
+    {
+      const size_t node = stack.back ();
+      stack.pop_back ();
+
+      const auto &n = nodes[node];
+
+      if (cutoff > 0.0)
+        {
+          const double d = min_distance (node, o);
+
+          if (n.max_luminosity < cutoff * d * d)
+            {
+              if (culled && !cone_misses (*this, node, cone))
+                *culled += n.end - n.begin;
+
+              continue;
+            }
+        }
+
+      if (cone_misses (*this, node, cone))
+        continue;
+
+      if (is_leaf (node))
+        {
+          if (!ranges.empty () && ranges.back ().end == n.begin)
+            ranges.back ().end = n.end;
+          else
+            ranges.push_back ({ n.begin, n.end });
+
+          continue;
+        }
+
+      // Right first so ranges come out in catalog order and merge.
+      stack.push_back (right (node));
+      stack.push_back (left (node));
+    }
+}
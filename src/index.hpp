@@ -0,0 +1,148 @@
+#ifndef INDEX_HPP
+#define INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "catalog.hpp"
+#include "tachyon.hpp"
+
+struct Query_Sphere
+{
+  t::vector3su center;
+  t::spatial_unit radius;
+};
+
+struct Query_Box
+{
+  t::vector3su lo, hi;
+};
+
+struct Query_Stats
+{
+  uint64_t count;
+  double luminosity_sum;
+  double luminosity_max;
+};
+
+// Receives query results in chunks of catalog indices. Chunks arrive from several threads at once
+// and in no particular order, so implementations must be thread-safe.
+struct Query_Sink
+{
+  virtual ~Query_Sink () = default;
+
+  virtual void write (const Catalog &catalog, const uint32_t *indices, size_t n) = 0;
+};
+
+// One "source_id,x_pc,y_pc,z_pc,luminosity" line per body.
+struct Query_Csv_Sink : Query_Sink
+{
+  std::ostream &out;
+  std::mutex mutex;
+
+  Query_Csv_Sink (std::ostream &_out);
+
+  void write (const Catalog &catalog, const uint32_t *indices, size_t n) override;
+};
+
+// Packed little-endian records: int64 source_id, then x_pc, y_pc, z_pc and luminosity as doubles.
+struct Query_Binary_Sink : Query_Sink
+{
+  std::ostream &out;
+  std::mutex mutex;
+
+  Query_Binary_Sink (std::ostream &_out);
+
+  void write (const Catalog &catalog, const uint32_t *indices, size_t n) override;
+};
+
+// Static k-d trees over body positions, one per half-decade of luminosity so that each node's
+// max_luminosity stays close to that of its faintest bodies and whole subtrees can be culled by
+// apparent flux. Nodes are stored in preorder (left child of i at i + 1) and every node owns a
+// contiguous range of the catalog, which build() reorders by bucket and then spatially.
+struct Body_Index
+{
+  static constexpr uint32_t LEAF_SIZE = 32;
+
+  struct Node
+  {
+    // Bounding box in Mm.
+    t::vector3f lo, hi;
+
+    double max_luminosity;
+
+    // Fastest body in the node, in Mm per year.
+    double max_speed;
+
+    uint32_t begin, end;
+
+    // Index of the right child; zero for leaves.
+    uint32_t right;
+  };
+
+  struct Range
+  {
+    uint32_t begin, end;
+  };
+
+  struct Pick
+  {
+    bool found;
+    size_t index;
+    double angle;
+  };
+
+  std::vector<Node> nodes;
+
+  // Root of each non-empty luminosity bucket, faintest first.
+  std::vector<size_t> roots;
+
+  // Catalog epoch (years) the boxes were built at, and how far the catalog has moved from it.
+  // Every bounding test pads a node by max_speed * drift so results stay conservative while the
+  // catalog is propagated without rebuilding the tree.
+  double built_epoch{ 0.0 };
+  double drift{ 0.0 };
+
+  Body_Index () = default;
+
+  void build (Catalog &catalog);
+
+  void set_epoch (double epoch);
+
+  bool empty () const;
+  bool is_leaf (size_t node) const;
+
+  size_t left (size_t node) const;
+  size_t right (size_t node) const;
+
+  // How far any body of the node may have moved since the tree was built, in Mm.
+  double padding (size_t node) const;
+
+  // Distance in Mm from a point to the node's bounding box, zero when inside.
+  double min_distance (size_t node, const t::vector3f &point) const;
+
+  // Brightest star (by apparent flux) within `tolerance` radians of the ray from `origin` along
+  // the unit vector `direction`.
+  Pick pick (const Catalog &catalog, const t::vector3su &origin, const t::vector3f &direction,
+             double tolerance) const;
+
+  // Catalog ranges of the leaves that may intersect a cone, in catalog order.
+  void cone (const t::vector3su &origin, const t::vector3f &direction, double half_angle,
+             std::vector<Range> &ranges) const;
+
+  // Like cone(), but also skips nodes whose brightest body cannot reach an apparent flux of
+  // `flux_min` (L☉ / AU²) from `origin`. Zero disables the flux test. `culled`, if given,
+  // receives how many bodies inside the cone (by bounding sphere) the flux test dropped.
+  void visible (const t::vector3su &origin, const t::vector3f &direction, double half_angle,
+                double flux_min, std::vector<Range> &ranges, uint64_t *culled = nullptr) const;
+
+  // Streams every body inside the region to `sink` (which may be null) and returns aggregates.
+  // Subtrees are traversed in parallel; nodes entirely inside the region skip per-body tests.
+  Query_Stats query (const Catalog &catalog, const Query_Sphere &sphere, Query_Sink *sink) const;
+  Query_Stats query (const Catalog &catalog, const Query_Box &box, Query_Sink *sink) const;
+};
+
+#endif // INDEX_HPP
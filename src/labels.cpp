@@ -0,0 +1,342 @@
+#include "labels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+// Where a label may go relative to its star, in order of preference: right below, right above,
+// left below and left above, as offsets of the top-left corner in units of the label's size plus
+// a gap in pixels.
+struct Placement
+{
+  float width, height;
+  float gap_x, gap_y;
+};
+
+constexpr Placement PLACEMENTS[] = {
+  { 0.0f, 0.0f, 5.0f, 3.0f },
+  { 0.0f, -1.0f, 5.0f, -3.0f },
+  { -1.0f, 0.0f, -5.0f, 3.0f },
+  { -1.0f, -1.0f, -5.0f, -3.0f },
+};
+
+bool
+parse_number (const std::string &field, double &value)
+{
+  char *end;
+
+  value = std::strtod (field.c_str (), &end);
+
+  return end != field.c_str () && *end == '\0';
+}
+} // namespace
+
+bool
+Label_Engine::load (const std::string &path)
+{
+  std::ifstream file (path);
+
+  if (!file.is_open ())
+    {
+      std::cerr << "ERROR: failed to open labels `" << path << "`.\n";
+      return false;
+    }
+
+  std::string line;
+  size_t number = 0;
+
+  while (std::getline (file, line))
+    {
+      number++;
+
+      if (!line.empty () && line.back () == '\r')
+        line.pop_back ();
+
+      if (line.empty () || line[0] == '#')
+        continue;
+
+      std::vector<std::string> fields;
+      std::stringstream ss (line);
+      std::string field;
+
+      while (std::getline (ss, field, ','))
+        fields.push_back (field);
+
+      Label label;
+      bool valid = false;
+
+      if (!fields.empty ())
+        label.name = fields[0];
+
+      if (fields.size () == 2)
+        {
+          char *end;
+
+          label.source_id = std::strtoll (fields[1].c_str (), &end, 10);
+          label.luminosity = 0.0;
+
+          valid = end != fields[1].c_str () && *end == '\0' && label.source_id > 0;
+        }
+      else if (fields.size () == 5)
+        {
+          double x, y, z;
+
+          valid = parse_number (fields[1], x) && parse_number (fields[2], y)
+                  && parse_number (fields[3], z) && parse_number (fields[4], label.luminosity);
+
+          label.source_id = 0;
+
+          if (valid)
+            label.position = t::vector3su{ t::spatial_unit::from_pc (x),
+                                           t::spatial_unit::from_pc (y),
+                                           t::spatial_unit::from_pc (z) };
+        }
+
+      if (!valid || label.name.empty ())
+        {
+          std::cerr << "ERROR: " << path << ":" << number
+                    << ": expected name,source_id or name,x_pc,y_pc,z_pc,luminosity.\n";
+          return false;
+        }
+
+      labels.push_back (std::move (label));
+    }
+
+  return true;
+}
+
+std::vector<int64_t>
+Label_Engine::source_ids () const
+{
+  std::vector<int64_t> ids (labels.size ());
+
+  for (size_t l = 0; l < labels.size (); ++l)
+    ids[l] = labels[l].source_id;
+
+  return ids;
+}
+
+void
+Label_Engine::resolve (const std::vector<uint32_t> &rows)
+{
+  by_row.clear ();
+
+  for (size_t l = 0; l < labels.size (); ++l)
+    {
+      labels[l].row = labels[l].source_id != 0 && l < rows.size () ? rows[l] : Label::NONE;
+
+      if (labels[l].row != Label::NONE)
+        by_row.push_back (static_cast<uint32_t> (l));
+    }
+
+  std::stable_sort (by_row.begin (), by_row.end (),
+                    [&] (uint32_t a, uint32_t b) { return labels[a].row < labels[b].row; });
+
+  // A source_id named twice keeps its first label.
+  auto last = std::unique (by_row.begin (), by_row.end (), [&] (uint32_t a, uint32_t b) {
+    if (labels[a].row != labels[b].row)
+      return false;
+
+    labels[b].row = Label::NONE;
+    return true;
+  });
+
+  by_row.erase (last, by_row.end ());
+}
+
+void
+Label_Engine::layout (const sf::Font &font)
+{
+  glyphs.clear ();
+
+  for (Label &label : labels)
+    {
+      label.first = glyphs.size ();
+
+      const sf::String text = sf::String::fromUtf8 (label.name.begin (), label.name.end ());
+
+      float x = 0.0f;
+      sf::Uint32 previous = 0;
+
+      for (const sf::Uint32 c : text)
+        {
+          x += font.getKerning (previous, c, CHARACTER_SIZE);
+          previous = c;
+
+          const sf::Glyph &glyph = font.getGlyph (c, CHARACTER_SIZE, false);
+
+          // Glyph bounds are relative to the baseline, which sits CHARACTER_SIZE below the top.
+          const float left = x + glyph.bounds.left;
+          const float top = CHARACTER_SIZE + glyph.bounds.top;
+          const float right = left + glyph.bounds.width;
+          const float bottom = top + glyph.bounds.height;
+
+          const float u0 = glyph.textureRect.left;
+          const float v0 = glyph.textureRect.top;
+          const float u1 = u0 + glyph.textureRect.width;
+          const float v1 = v0 + glyph.textureRect.height;
+
+          x += glyph.advance;
+
+          if (glyph.bounds.width <= 0 || glyph.bounds.height <= 0)
+            continue;
+
+          sf::Vertex corners[4];
+
+          corners[0].position = { left, top };
+          corners[0].texCoords = { u0, v0 };
+          corners[1].position = { right, top };
+          corners[1].texCoords = { u1, v0 };
+          corners[2].position = { left, bottom };
+          corners[2].texCoords = { u0, v1 };
+          corners[3].position = { right, bottom };
+          corners[3].texCoords = { u1, v1 };
+
+          for (int corner : { 0, 1, 2, 2, 1, 3 })
+            glyphs.push_back (corners[corner]);
+        }
+
+      label.count = glyphs.size () - label.first;
+      label.width = x;
+      label.height = font.getLineSpacing (CHARACTER_SIZE);
+    }
+}
+
+void
+Label_Engine::place (const Catalog &catalog, const Body_Index &index, const Camera &camera,
+                     double flux_cutoff)
+{
+  candidates.clear ();
+  vertices.clear ();
+  placed = 0;
+
+  if (labels.empty ())
+    return;
+
+  const Projection projection (camera);
+  const double flux_min = flux_cutoff * FLUX_FACTOR;
+
+  auto consider = [&] (uint32_t l, const t::vector3su &position, double luminosity) {
+    const auto dx = (projection.position.x - position.x).as_AU ();
+    const auto dy = (projection.position.y - position.y).as_AU ();
+    const auto dz = (projection.position.z - position.z).as_AU ();
+
+    const double flux = luminosity / (dx * dx + dy * dy + dz * dz);
+
+    if (!(flux >= flux_min))
+      return;
+
+    const auto p = projection.apply (position);
+
+    if (p.z == 0 || p.x < 0 || p.y < 0 || p.x >= WW || p.y >= WH)
+      return;
+
+    candidates.push_back ({ l, static_cast<float> (p.x), static_cast<float> (p.y), flux });
+  };
+
+  // Stars: only those in the index's visible leaves, found by merging both lists in row order.
+  index.visible (camera.position,
+                 projection.unproject (projection.half_width, projection.half_height),
+                 projection.half_angle (), flux_min, ranges);
+
+  auto it = by_row.begin ();
+
+  for (const auto &range : ranges)
+    {
+      it = std::lower_bound (it, by_row.end (), range.begin,
+                             [&] (uint32_t l, uint32_t row) { return labels[l].row < row; });
+
+      for (; it != by_row.end () && labels[*it].row < range.end; ++it)
+        {
+          const Body &body = catalog.bodies[labels[*it].row];
+
+          consider (*it, body.position, body.luminosity);
+        }
+    }
+
+  for (size_t l = 0; l < labels.size (); ++l)
+    if (labels[l].source_id == 0)
+      consider (l, labels[l].position, labels[l].luminosity);
+
+  std::sort (candidates.begin (), candidates.end (),
+             [] (const Candidate &a, const Candidate &b) { return a.flux > b.flux; });
+
+  const int columns = (WW + CELL - 1) / CELL;
+  const int rows = (WH + CELL - 1) / CELL;
+
+  grid.assign (columns * rows, 0);
+
+  for (const Candidate &candidate : candidates)
+    {
+      if (placed == MAX_PLACED)
+        break;
+
+      const Label &label = labels[candidate.label];
+
+      for (const Placement &placement : PLACEMENTS)
+        {
+          const float left
+              = std::floor (candidate.x + placement.width * label.width + placement.gap_x);
+          const float top
+              = std::floor (candidate.y + placement.height * label.height + placement.gap_y);
+
+          if (left < 0 || top < 0 || left + label.width > WW || top + label.height > WH)
+            continue;
+
+          const int c0 = left / CELL, c1 = (left + label.width) / CELL;
+          const int r0 = top / CELL, r1 = (top + label.height) / CELL;
+
+          bool free = true;
+
+          for (int r = r0; r <= r1 && r < rows && free; ++r)
+            for (int c = c0; c <= c1 && c < columns; ++c)
+              if (grid[r * columns + c])
+                {
+                  free = false;
+                  break;
+                }
+
+          if (!free)
+            continue;
+
+          for (int r = r0; r <= r1 && r < rows; ++r)
+            for (int c = c0; c <= c1 && c < columns; ++c)
+              grid[r * columns + c] = 1;
+
+          // Brighter stars get more opaque names.
+          const double alpha
+              = flux_min > 0 ? 96.0 + 48.0 * std::log10 (candidate.flux / flux_min) : 255.0;
+
+          const sf::Color color{ 160, 160, 160, static_cast<uint8_t> (std::min (alpha, 255.0)) };
+
+          for (uint32_t g = label.first; g < label.first + label.count; ++g)
+            {
+              sf::Vertex vertex = glyphs[g];
+
+              vertex.position.x += left;
+              vertex.position.y += top;
+              vertex.color = color;
+
+              vertices.push_back (vertex);
+            }
+
+          placed++;
+          break;
+        }
+    }
+}
+
+void
+Label_Engine::draw (sf::RenderTarget &target, const sf::Font &font) const
+{
+  if (vertices.empty ())
+    return;
+
+  target.draw (vertices.data (), vertices.size (), sf::Triangles,
+               sf::RenderStates (&font.getTexture (CHARACTER_SIZE)));
+}
@@ -0,0 +1,101 @@
+#ifndef LABELS_HPP
+#define LABELS_HPP
+
+#include <SFML/Graphics.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "camera.hpp"
+#include "catalog.hpp"
+#include "index.hpp"
+
+// A named object: a catalog star, found by source_id, or anything else (a cluster, say) at a fixed
+// position with a luminosity to rank it by.
+struct Label
+{
+  static constexpr uint32_t NONE = UINT32_MAX;
+
+  std::string name;
+
+  int64_t source_id;
+
+  // Catalog row of source_id, or NONE for fixed labels and stars the catalog lacks.
+  uint32_t row{ NONE };
+
+  t::vector3su position;
+  double luminosity;
+
+  // The name's glyphs in `Label_Engine::glyphs`, and its size in pixels.
+  uint32_t first{ 0 }, count{ 0 };
+  float width{ 0.0f }, height{ 0.0f };
+};
+
+// Names for thousands of objects at a cost that hardly depends on how many there are. Each frame
+// the index culls labelled stars outside the view cone or too faint to deserve a name, the rest
+// are ranked by apparent flux and placed brightest first on a coarse screen grid, skipping any
+// that would overlap one already placed, and the survivors' glyphs go into one vertex array that
+// is drawn in a single call with the font's texture.
+struct Label_Engine
+{
+  static constexpr unsigned CHARACTER_SIZE = 14;
+
+  // Side of a collision grid cell in pixels.
+  static constexpr int CELL = 8;
+
+  // A label needs this many times the flux that makes its star visible at all.
+  static constexpr double FLUX_FACTOR = 100.0;
+
+  // At most this many labels are placed per frame.
+  static constexpr size_t MAX_PLACED = 1024;
+
+  struct Candidate
+  {
+    uint32_t label;
+    float x, y;
+    double flux;
+  };
+
+  std::vector<Label> labels;
+
+  // Catalog labels ordered by row, for merging with the index's ranges; rebuilt by resolve().
+  std::vector<uint32_t> by_row;
+
+  // Glyph quads (two triangles each) of every name, laid out from its top-left corner.
+  std::vector<sf::Vertex> glyphs;
+
+  // Per-frame state.
+  std::vector<Body_Index::Range> ranges;
+  std::vector<Candidate> candidates;
+  std::vector<uint8_t> grid;
+  std::vector<sf::Vertex> vertices;
+  size_t placed{ 0 };
+
+  // Appends the labels of a CSV file, one per line:
+  //
+  //   name,source_id
+  //   name,x_pc,y_pc,z_pc,luminosity
+  //
+  // Lines starting with `#` are skipped; names may not contain commas.
+  bool load (const std::string &path);
+
+  // Source_id of every label, zero for fixed ones, for rows_of().
+  std::vector<int64_t> source_ids () const;
+
+  // Takes the catalog row of every label from `rows`, as rows_of() found them for source_ids();
+  // call again whenever the catalog is replaced.
+  void resolve (const std::vector<uint32_t> &rows);
+
+  // Lays out every name's glyphs once, so placing a label only translates them.
+  void layout (const sf::Font &font);
+
+  // Places the labels visible from the camera over the whole window. `flux_cutoff` is the flux
+  // that makes a star visible, as for Body_Index::visible().
+  void place (const Catalog &catalog, const Body_Index &index, const Camera &camera,
+              double flux_cutoff);
+
+  void draw (sf::RenderTarget &target, const sf::Font &font) const;
+};
+
+#endif // LABELS_HPP
@@ -0,0 +1,188 @@
+#include "log.hpp"
+
+#include <chrono>
+#include <cstdarg>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+const char *const LEVEL_NAMES[LOG_COUNT] = { "trace", "debug", "info", "warn", "error", "off" };
+
+uint64_t
+now_ns ()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds> (
+             std::chrono::steady_clock::now ().time_since_epoch ())
+      .count ();
+}
+} // namespace
+
+const char *
+log_level_name (Log_Level level)
+{
+  return level < LOG_COUNT ? LEVEL_NAMES[level] : "?";
+}
+
+Log_Level
+log_level_from (const char *name)
+{
+  for (uint32_t level = 0; level < LOG_COUNT; ++level)
+    if (std::strcmp (name, LEVEL_NAMES[level]) == 0)
+      return static_cast<Log_Level> (level);
+
+  return LOG_COUNT;
+}
+
+Log_Channel::Log_Channel ()
+    : slots (new Slot[CAPACITY]), current (stderr), output (stderr), start_ns (now_ns ())
+{
+  for (size_t i = 0; i < CAPACITY; ++i)
+    slots[i].sequence.store (i, std::memory_order_relaxed);
+
+  drain = std::thread (&Log_Channel::run, this);
+}
+
+Log_Channel::~Log_Channel ()
+{
+  quit = true;
+  drain.join ();
+
+  if (current != stderr)
+    std::fclose (current);
+}
+
+bool
+Log_Channel::open (const char *path)
+{
+  FILE *file = std::fopen (path, "a");
+
+  if (!file)
+    {
+      std::cerr << "ERROR: failed to open log `" << path << "`.\n";
+      return false;
+    }
+
+  output = file;
+
+  return true;
+}
+
+void
+Log_Channel::write (Log_Level _level, const char *format, ...)
+{
+  if (_level < level.load (std::memory_order_relaxed) || _level >= LOG_OFF)
+    return;
+
+  // Claim the slot at `head` once the drain thread has released it; a full ring drops the record.
+  uint64_t position = head.load (std::memory_order_relaxed);
+  Slot *slot;
+
+  while (true)
+    {
+      slot = &slots[position % CAPACITY];
+
+      const uint64_t sequence = slot->sequence.load (std::memory_order_acquire);
+      const int64_t lag = static_cast<int64_t> (sequence - position);
+
+      if (lag == 0)
+        {
+          if (head.compare_exchange_weak (position, position + 1, std::memory_order_relaxed))
+            break;
+        }
+      else if (lag < 0)
+        {
+          dropped.fetch_add (1, std::memory_order_relaxed);
+          return;
+        }
+      else
+        position = head.load (std::memory_order_relaxed);
+    }
+
+  Log_Record &record = slot->record;
+
+  record.time_ns = now_ns () - start_ns;
+  record.level = _level;
+
+  va_list args;
+
+  va_start (args, format);
+  std::vsnprintf (record.text, sizeof record.text, format, args);
+  va_end (args);
+
+  slot->sequence.store (position + 1, std::memory_order_release);
+}
+
+bool
+Log_Channel::pop (Log_Record &record)
+{
+  Slot &slot = slots[tail % CAPACITY];
+
+  if (slot.sequence.load (std::memory_order_acquire) != tail + 1)
+    return false;
+
+  record = slot.record;
+
+  // Free for the writer that comes round the ring next.
+  slot.sequence.store (tail + CAPACITY, std::memory_order_release);
+  tail++;
+
+  return true;
+}
+
+void
+Log_Channel::run ()
+{
+  Log_Record record;
+
+  while (true)
+    {
+      // Read before draining, so nothing written before quit is left behind.
+      const bool last = quit;
+
+      FILE *wanted = output;
+
+      if (wanted != current)
+        {
+          if (current != stderr)
+            std::fclose (current);
+
+          current = wanted;
+        }
+
+      bool any = false;
+
+      while (pop (record))
+        {
+          std::fprintf (current, "[%12.6f] %-5s %s\n", record.time_ns * 1e-9,
+                        LEVEL_NAMES[record.level], record.text);
+          any = true;
+        }
+
+      const uint64_t lost = dropped;
+
+      if (lost != reported)
+        {
+          std::fprintf (current, "%lu log record(s) dropped\n", lost - reported);
+          reported = lost;
+          any = true;
+        }
+
+      if (any)
+        std::fflush (current);
+
+      if (last)
+        break;
+
+      if (!any)
+        std::this_thread::sleep_for (std::chrono::milliseconds (DRAIN_INTERVAL_MS));
+    }
+}
+
+Log_Channel &
+log_channel ()
+{
+  static Log_Channel channel;
+
+  return channel;
+}
@@ -0,0 +1,93 @@
+#ifndef LOG_HPP
+#define LOG_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+enum Log_Level : uint32_t
+{
+  LOG_TRACE,
+  LOG_DEBUG,
+  LOG_INFO,
+  LOG_WARN,
+  LOG_ERROR,
+  LOG_OFF,
+
+  LOG_COUNT
+};
+
+const char *log_level_name (Log_Level level);
+
+// LOG_COUNT on an unknown name.
+Log_Level log_level_from (const char *name);
+
+// One message, formatted by the writer and truncated to fit.
+struct Log_Record
+{
+  static constexpr size_t TEXT_SIZE = 116;
+
+  // Since the channel was created.
+  uint64_t time_ns;
+  Log_Level level;
+  char text[TEXT_SIZE];
+};
+
+// Logging and telemetry that never blocks the writer. write() formats into a fixed-size record in
+// a bounded lock-free ring (a sequence number per slot, so any thread may write) and returns; a
+// background thread drains the ring to stderr or a file. When the ring is full the record is
+// dropped and counted instead of waited for. Records below `level`, which may be changed at any
+// time, cost one atomic load.
+struct Log_Channel
+{
+  static constexpr size_t CAPACITY = 4096;
+
+  // How long the drain thread sleeps when it finds the ring empty.
+  static constexpr int DRAIN_INTERVAL_MS = 5;
+
+  struct Slot
+  {
+    std::atomic<uint64_t> sequence;
+    Log_Record record;
+  };
+
+  std::atomic<Log_Level> level{ LOG_INFO };
+  std::atomic<uint64_t> dropped{ 0 };
+
+  std::unique_ptr<Slot[]> slots;
+  std::atomic<uint64_t> head{ 0 };
+
+  // Drain thread state.
+  uint64_t tail{ 0 };
+  uint64_t reported{ 0 };
+  FILE *current;
+
+  // Where records go; swapped in by the drain thread, which closes the old file.
+  std::atomic<FILE *> output;
+  std::atomic<bool> quit{ false };
+
+  const uint64_t start_ns;
+
+  std::thread drain;
+
+  Log_Channel ();
+  ~Log_Channel ();
+
+  Log_Channel (const Log_Channel &) = delete;
+  Log_Channel &operator= (const Log_Channel &) = delete;
+
+  // Sends records to `path` (appending) instead of stderr.
+  bool open (const char *path);
+
+  void write (Log_Level _level, const char *format, ...) __attribute__ ((format (printf, 3, 4)));
+
+  bool pop (Log_Record &record);
+  void run ();
+};
+
+// The process-wide channel.
+Log_Channel &log_channel ();
+
+#endif // LOG_HPP
@@ -3,257 +3,330 @@
 #include <omp.h>
 
 #include <cmath>
+#include <cstdlib>
 #include <cstring>
+#include <ctime>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
 
+#include "batch.hpp"
+#include "capture.hpp"
+#include "camera.hpp"
+#include "catalog.hpp"
+#include "common.hpp"
+#include "density.hpp"
+#include "governor.hpp"
+#include "index.hpp"
+#include "labels.hpp"
+#include "log.hpp"
+#include "metering.hpp"
+#include "pack.hpp"
+#include "progressive.hpp"
+#include "query.hpp"
+#include "reload.hpp"
+#include "render.hpp"
+#include "serve.hpp"
 #include "tachyon.hpp"
-
-namespace t = tachyon;
+#include "tachyon_ephemeris.hpp"
+#include "tachyon_frame.hpp"
+#include "timing.hpp"
+#include "views.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static constexpr auto PI = 3.1415927;
-static constexpr auto PI_2 = PI / 2;
-static constexpr auto TAU = PI * 2;
+static sf::RenderWindow window;
+static sf::Font font;
+static Camera camera;
+static t::ephemeris ephemeris;
 
-#define RAD(a) ((a) * (PI / 180.0f))
-#define DEG(a) ((a) / (PI / 180.0f))
+struct Solar_Body_Style
+{
+  const char *name;
+  sf::Color color;
+};
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
+static const Solar_Body_Style SOLAR_BODY_STYLES[] = {
+  { "Mercury", sf::Color{ 169, 169, 169 } }, { "Venus", sf::Color{ 218, 165, 32 } },
+  { "Earth", sf::Color{ 0, 102, 204 } },     { "Mars", sf::Color{ 188, 39, 50 } },
+  { "Jupiter", sf::Color{ 216, 179, 130 } }, { "Saturn", sf::Color{ 210, 180, 140 } },
+  { "Uranus", sf::Color{ 173, 216, 230 } },  { "Neptune", sf::Color{ 63, 84, 186 } },
+  { "Pluto", sf::Color{ 200, 155, 109 } },   { "Moon", sf::Color{ 128, 128, 128 } },
+};
 
-struct Gaia_Object
+static sf::Color
+solar_body_color (const std::string &name)
 {
-  int64_t source_id;
-  double ra;
-  double dec;
-  double parallax;
-  double lum_flame;
-
-  Gaia_Object () = default;
+  for (const auto &style : SOLAR_BODY_STYLES)
+    if (name == style.name)
+      return style.color;
 
-  static Gaia_Object
-  from (std::string line)
-  {
-    Gaia_Object object;
+  return sf::Color{ 128, 128, 128 };
+}
 
-    std::stringstream ss (line);
-    std::string token;
+void
+mark_body (std::string name, t::vector3su position, sf::Color color, bool label = true)
+{
+  auto p = project (camera, position);
 
-    std::getline (ss, token, ',');
-    object.source_id = std::stoll (token);
+  if (p.z != 0)
+    {
+      sf::CircleShape circle (5);
 
-    std::getline (ss, token, ',');
-    object.ra = std::stod (token);
+      circle.setOrigin ({ 5, 5 });
 
-    std::getline (ss, token, ',');
-    object.dec = std::stod (token);
+      circle.setPosition ({ (float)p.x, (float)p.y });
 
-    std::getline (ss, token, ',');
-    object.parallax = std::stod (token);
+      circle.setOutlineThickness (2);
 
-    std::getline (ss, token, ',');
-    object.lum_flame = std::stod (token);
+      circle.setOutlineColor (color);
 
-    return object;
-  }
-};
+      circle.setFillColor (sf::Color::Transparent);
 
-struct Body
-{
-  t::vector3su position;
+      window.draw (circle);
 
-  double luminosity;
+      if (!label)
+        return;
 
-  Body () = default;
+      sf::Text text;
 
-  Body (Gaia_Object object)
-  {
-    double r_rad = RAD (object.ra);
-    double d_rad = RAD (object.dec);
-    double distance_pc = object.parallax != 0.0 ? 1000.0 / object.parallax : 0.0;
+      text.setFont (font);
 
-    position.x = t::spatial_unit::from_pc (distance_pc * cos (d_rad) * cos (r_rad));
-    position.y = t::spatial_unit::from_pc (distance_pc * cos (d_rad) * sin (r_rad));
-    position.z = t::spatial_unit::from_pc (distance_pc * sin (d_rad));
+      text.setString (sf::String::fromUtf8 (name.begin (), name.end ()));
 
-    luminosity = object.lum_flame;
-  }
-};
+      text.setCharacterSize (16);
 
-struct Gaia_Source
-{
-  std::vector<Gaia_Object> objects;
+      text.setFillColor (sf::Color{ 128, 128, 128, color.a });
 
-  Gaia_Source () = default;
+      text.setPosition ({ (float)p.x + 5, (float)p.y + 5 });
 
-  bool
-  load (std::string path)
-  {
-    std::ifstream file (path);
+      window.draw (text);
+    }
+}
 
-    if (!file.is_open ())
-      return false;
+////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    std::string line;
+static constexpr size_t ORBIT_SEGMENTS_MIN = 32;
+static constexpr size_t ORBIT_SEGMENTS_MAX = 2048;
 
-    std::getline (file, line); // HEADER
+// Keplerian orbit whose polylines are generated once per level of detail, in ecliptic coordinates
+// rotated into the equatorial frame the catalog lives in. Only the origin may move per frame.
+struct Orbit
+{
+  enum Fade
+  {
+    SOLAR,
+    LUNAR,
+  };
 
-    while (std::getline (file, line))
-      objects.push_back (Gaia_Object::from (line));
+  t::vector3su origin;
+  t::orbital_elements elements;
+  sf::Color color;
+  Fade fade;
 
-    if (file.bad ())
-      return false;
+  // levels[k] holds ORBIT_SEGMENTS_MIN << k points, relative to the origin.
+  std::vector<std::vector<t::vector3su>> levels;
 
-    if (!file.eof ())
-      return false;
+  Orbit (t::vector3su _origin, t::orbital_elements _elements, sf::Color _color,
+         Fade _fade = SOLAR)
+      : origin (_origin), elements (_elements), color (_color), fade (_fade)
+  {
+  }
 
-    return true;
+  t::spatial_unit
+  apoapsis () const
+  {
+    return t::spatial_unit::from_AU (elements.a_AU * (1.0 + elements.e));
   }
 
-  std::vector<Body>
-  to_bodies () const
+  const std::vector<t::vector3su> &
+  polyline (size_t segments)
   {
-    std::vector<Body> bodies;
+    size_t level = 0;
 
-    bodies.reserve (objects.size ());
+    while ((ORBIT_SEGMENTS_MIN << level) < segments)
+      level++;
 
-    for (const auto &object : objects)
-      bodies.emplace_back (object);
+    if (levels.size () <= level)
+      levels.resize (level + 1);
 
-    return bodies;
-  }
-};
+    auto &points = levels[level];
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
+    if (points.empty ())
+      {
+        const size_t n = ORBIT_SEGMENTS_MIN << level;
 
-#if 0
-constexpr uint32_t WW = 800;
-constexpr uint32_t WH = 600;
-#else
-constexpr uint32_t WW = 1920;
-constexpr uint32_t WH = 1080;
-#endif
+        const double a = t::spatial_unit::from_AU (elements.a_AU).as_Mm ();
+        const double b = a * std::sqrt (1.0 - elements.e * elements.e);
 
-constexpr uint32_t FPS = 144;
+        const double ci = cos (RAD (elements.i_deg)), si = sin (RAD (elements.i_deg));
+        const double cn = cos (RAD (elements.node_deg)), sn = sin (RAD (elements.node_deg));
+        const double cw = cos (RAD (elements.peri_deg)), sw = sin (RAD (elements.peri_deg));
+        const t::rotation3 to_icrs = t::frame_rotation (t::frame::ecliptic, t::frame::icrs);
 
-struct Camera
-{
-  t::vector3su position;
-  double y;
-  double p;
-  double d;
+        points.reserve (n);
 
-  double focal_length;
+        for (size_t i = 0; i < n; ++i)
+          {
+            const double E = TAU * i / n;
 
-  double f;
-  double t;
-  double iso;
+            const double xp = a * (cos (E) - elements.e);
+            const double yp = b * sin (E);
 
-  double N_photon = 1e6;
-};
+            const double ex = (cw * cn - sw * sn * ci) * xp + (-sw * cn - cw * sn * ci) * yp;
+            const double ey = (cw * sn + sw * cn * ci) * xp + (-sw * sn + cw * cn * ci) * yp;
+            const double ez = (sw * si) * xp + (cw * si) * yp;
 
-static sf::RenderWindow window;
-static sf::Font font;
-static Camera camera;
+            const auto p = to_icrs.apply (t::vector3f (ex, ey, ez));
 
-t::vector3f
-project (Camera camera, const t::vector3su &point)
-{
-  const auto distance = point - camera.position;
+            points.emplace_back (std::llround (p.x), std::llround (p.y), std::llround (p.z));
+          }
+      }
 
-  const int64_t tx = distance.x.as_Mm ();
-  const int64_t ty = distance.y.as_Mm ();
-  const int64_t tz = distance.z.as_Mm ();
+    return points;
+  }
+};
 
-  double rx = -ty * cos (camera.y) + tx * sin (camera.y);
-  double ry = tx * cos (camera.y) + ty * sin (camera.y);
-  double rz = tz * cos (camera.p) - ry * sin (camera.p);
+// Picks a segment count so that each segment spans a few pixels on screen.
+static size_t
+orbit_segments (const Projection &projection, const Orbit &orbit, double pixels_per_segment)
+{
+  const auto c = projection.view (orbit.origin);
 
-  ry = tz * sin (camera.p) + ry * cos (camera.p);
+  const double R = orbit.apoapsis ().as_Mm ();
+  const double D = std::sqrt (c.x * c.x + c.y * c.y + c.z * c.z);
 
-  if (ry <= 0)
-    return tachyon::vector3f::ZERO;
+  if (D <= R)
+    return ORBIT_SEGMENTS_MAX;
 
-  const auto sx = static_cast<double> (rx) / -ry * camera.d + WW / 2.0;
-  const auto sy = static_cast<double> (rz) / -ry * camera.d + WH / 2.0;
-  const auto sz = ry;
+  const double pixels = R / (D - R) * projection.d;
+  const double segments = TAU * pixels / pixels_per_segment;
 
-  return tachyon::vector3f{ sx, sy, sz };
+  return std::clamp (static_cast<size_t> (segments), ORBIT_SEGMENTS_MIN, ORBIT_SEGMENTS_MAX);
 }
 
+// Projects every visible orbit in one pass and emits the strips as a single batch of lines, broken
+// wherever a point falls behind the camera.
 void
-mark_body (std::string name, t::vector3su position, sf::Color color)
+draw_orbits (sf::VertexArray &vao, std::vector<Orbit> &orbits, uint8_t a_solar, uint8_t a_moon,
+             double pixels_per_segment)
 {
-  auto p = project (camera, position);
+  const Projection projection (camera);
 
-  if (p.z != 0)
+  static std::vector<t::vector3su> points;
+  static std::vector<t::vector3f> projected;
+
+  struct Span
+  {
+    size_t begin, end;
+    sf::Color color;
+  };
+
+  static std::vector<Span> spans;
+
+  points.clear ();
+  spans.clear ();
+
+  for (auto &orbit : orbits)
     {
-      sf::CircleShape circle (5);
+      sf::Color color = orbit.color;
 
-      circle.setOrigin ({ 5, 5 });
+      color.a = orbit.fade == Orbit::LUNAR ? a_moon : a_solar;
 
-      circle.setPosition ({ (float)p.x, (float)p.y });
+      if (color.a == 0)
+        continue;
 
-      circle.setOutlineThickness (2);
+      // Whole orbit behind the camera.
+      if (projection.view (orbit.origin).y + orbit.apoapsis ().as_Mm () <= 0)
+        continue;
 
-      circle.setOutlineColor (color);
+      const auto segments = orbit_segments (projection, orbit, pixels_per_segment);
+      const auto &polyline = orbit.polyline (segments);
 
-      circle.setFillColor (sf::Color::Transparent);
+      const size_t begin = points.size ();
 
-      window.draw (circle);
+      for (const auto &offset : polyline)
+        points.push_back (orbit.origin + offset);
 
-      sf::Text text;
+      spans.push_back ({ begin, points.size (), color });
+    }
 
-      text.setFont (font);
+  projected.resize (points.size ());
 
-      text.setString (name);
+  project_batch (camera, points.data (), points.size (), projected.data ());
 
-      text.setCharacterSize (16);
+  vao.setPrimitiveType (sf::Lines);
+  vao.clear ();
 
-      text.setFillColor (sf::Color{ 128, 128, 128, color.a });
+  for (const auto &span : spans)
+    for (size_t i = span.begin; i < span.end; ++i)
+      {
+        const auto &a = projected[i];
+        const auto &b = projected[i + 1 < span.end ? i + 1 : span.begin];
 
-      text.setPosition ({ (float)p.x + 5, (float)p.y + 5 });
+        if (a.z == 0 || b.z == 0)
+          continue;
 
-      window.draw (text);
-    }
+        vao.append (sf::Vertex ({ (float)a.x, (float)a.y }, span.color));
+        vao.append (sf::Vertex ({ (float)b.x, (float)b.y }, span.color));
+      }
+
+  window.draw (vao);
 }
 
+// Density map resolutions; the textures are stretched to fit the window.
+static constexpr uint32_t MAP_PLANE_SIZE = 768;
+static constexpr uint32_t MAP_SKY_WIDTH = 1024;
+static constexpr uint32_t MAP_SKY_HEIGHT = 512;
+
+// Range the plane map's extent zooms over, in parsecs; far inside what a spatial_unit holds,
+// and never so small that a map cell shrinks to nothing.
+static constexpr double MAP_EXTENT_MIN_PC = 1.0;
+static constexpr double MAP_EXTENT_MAX_PC = 100000.0;
+
+// Fits the map's texture in the window and marks where the camera is on the galactic plane, or
+// where it looks on the sky.
 void
-circle_around (sf::VertexArray &vao, t::vector3su origin, t::spatial_unit radius, sf::Color color,
-               double inclination_deg = 0.0)
+draw_density_map (const Density_Map &map, const sf::Texture &texture)
 {
-  const double inclination_rad = RAD (inclination_deg);
+  const float scale = std::min (WW / (float)map.width, WH / (float)map.height);
 
-  sf::VertexArray lines (sf::LineStrip);
+  const sf::Vector2f origin ((WW - map.width * scale) / 2, (WH - map.height * scale) / 2);
 
-  for (float phi = 0; phi < 360; phi += 1)
-    {
-      const double phi_rad = RAD (phi);
+  sf::Sprite sprite (texture);
 
-      const auto x = radius * cos (phi_rad);
-      const auto y = radius * sin (phi_rad) * cos (inclination_rad);
-      const auto z = radius * sin (phi_rad) * sin (inclination_rad);
+  sprite.setScale (scale, scale);
+  sprite.setPosition (origin);
 
-      t::vector3su point;
-      point.x = origin.x + x;
-      point.y = origin.y + y;
-      point.z = origin.z + z;
+  window.draw (sprite);
 
-      auto p = project (camera, point);
+  t::vector3su marker = camera.position;
 
-      if (p.z != 0)
-        {
-          sf::Vertex vertex;
-          vertex.position = { static_cast<float> (p.x), static_cast<float> (p.y) };
-          vertex.color = color;
-          vao.append (vertex);
-        }
+  if (map.view == DENSITY_SKY)
+    {
+      const Projection projection (camera);
+
+      const auto direction = projection.unproject (projection.half_width, projection.half_height);
+
+      marker = t::vector3su (std::llround (direction.x * 1e12), std::llround (direction.y * 1e12),
+                             std::llround (direction.z * 1e12));
     }
 
-  window.draw (lines);
+  double u, v;
+
+  if (!map.locate (marker, u, v))
+    return;
+
+  sf::CircleShape circle (5);
+
+  circle.setOrigin ({ 5, 5 });
+  circle.setPosition (origin + sf::Vector2f (u * scale, v * scale));
+  circle.setOutlineThickness (2);
+  circle.setOutlineColor (sf::Color::White);
+  circle.setFillColor (sf::Color::Transparent);
+
+  window.draw (circle);
 }
 
 void
@@ -387,53 +460,39 @@ double_to_human (double x, char buffer[], size_t size)
   snprintf (buffer, size, "%.1f%s", display, suffix);
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////
-
-static inline double
-srgb8_to_linear (uint8_t c)
+void
+jd_to_human (double jd, char buffer[], size_t size)
 {
-  const double cs = c / 255.0;
+  const double z = std::floor (jd + 0.5);
+  const double f = jd + 0.5 - z;
 
-  if (cs <= 0.04045)
-    return cs / 12.92;
-  else
-    return std::pow ((cs + 0.055) / 1.055, 2.4);
-}
-
-static inline uint8_t
-linear_to_srgb8 (double linear)
-{
-  linear = std::max (0.0, linear);
+  const double alpha = std::floor ((z - 1867216.25) / 36524.25);
+  const double a = z + 1 + alpha - std::floor (alpha / 4);
+  const double b = a + 1524;
+  const double c = std::floor ((b - 122.1) / 365.25);
+  const double d = std::floor (365.25 * c);
+  const double e = std::floor ((b - d) / 30.6001);
 
-  double srgb;
+  const int day = b - d - std::floor (30.6001 * e);
+  const int month = e < 14 ? e - 1 : e - 13;
+  const int year = month > 2 ? c - 4716 : c - 4715;
 
-  if (linear <= 0.0031308)
-    srgb = 12.92 * linear;
-  else
-    srgb = 1.055 * std::pow (linear, 1.0 / 2.4) - 0.055;
+  const int minutes = std::floor (f * 24 * 60);
 
-  return static_cast<uint8_t> (std::lround (std::clamp (srgb * 255.0, 0.0, 255.0)));
+  snprintf (buffer, size, "%04d-%02d-%02d %02d:%02d", year, month, day, minutes / 60,
+            minutes % 60);
 }
 
-void
-applyIntensity_uint8 (uint8_t inR, uint8_t inG, uint8_t inB, double I, uint8_t &outR, uint8_t &outG,
-                      uint8_t &outB)
-{
-  double lr = srgb8_to_linear (inR);
-  double lg = srgb8_to_linear (inG);
-  double lb = srgb8_to_linear (inB);
-
-  lr *= I;
-  lg *= I;
-  lb *= I;
+////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  lr = lr / (1.0 + lr);
-  lg = lg / (1.0 + lg);
-  lb = lb / (1.0 + lb);
+double
+distance_AU (const t::vector3su &a, const t::vector3su &b)
+{
+  const auto dx = (a.x - b.x).as_AU ();
+  const auto dy = (a.y - b.y).as_AU ();
+  const auto dz = (a.z - b.z).as_AU ();
 
-  outR = linear_to_srgb8 (lr);
-  outG = linear_to_srgb8 (lg);
-  outB = linear_to_srgb8 (lb);
+  return std::sqrt (dx * dx + dy * dy + dz * dz);
 }
 
 double
@@ -444,17 +503,94 @@ angle_normalize (double a)
 
 
 int
-main ()
+main (int argc, char *argv[])
 {
+  if (argc > 1 && strcmp (argv[1], "query") == 0)
+    return query_main (argc - 1, argv + 1);
+
+  if (argc > 1 && strcmp (argv[1], "render") == 0)
+    return render_main (argc - 1, argv + 1);
+
+  if (argc > 1 && strcmp (argv[1], "pack") == 0)
+    return pack_main (argc - 1, argv + 1);
+
+  if (argc > 1 && strcmp (argv[1], "serve") == 0)
+    return serve_main (argc - 1, argv + 1);
+
+  std::vector<std::string> catalog_paths;
+  std::vector<std::string> label_paths;
+
+  // CPU time per frame the quality governor aims for; zero turns it off.
+  double target_ms = 6.9;
+
+  // Reload the catalog in the background when its files change.
+  bool watch = true;
+
+  for (int i = 1; i < argc; ++i)
+    {
+      if (strcmp (argv[i], "--target") == 0 && i + 1 < argc)
+        target_ms = std::atof (argv[++i]);
+      else if (strcmp (argv[i], "--catalog") == 0 && i + 1 < argc)
+        catalog_paths.push_back (argv[++i]);
+      else if (strcmp (argv[i], "--labels") == 0 && i + 1 < argc)
+        label_paths.push_back (argv[++i]);
+      else if (strcmp (argv[i], "--no-watch") == 0)
+        watch = false;
+      else if (strcmp (argv[i], "--log") == 0 && i + 1 < argc)
+        {
+          if (!log_channel ().open (argv[++i]))
+            return 1;
+        }
+      else if (strcmp (argv[i], "--log-level") == 0 && i + 1 < argc
+               && log_level_from (argv[i + 1]) != LOG_COUNT)
+        log_channel ().level = log_level_from (argv[++i]);
+      else
+        {
+          std::cerr << "usage: [--target MS] [--catalog PATH]... [--labels PATH]... [--no-watch]\n"
+                       "       [--log PATH] [--log-level trace|debug|info|warn|error|off]\n"
+                       "       query ... | render ... | pack ... | serve ...\n";
+          return 1;
+        }
+    }
+
   omp_set_num_threads (std::max (omp_get_num_procs () / 2, 1));
 
   //////////////////////////////////////////////////////////////////////////////////////////////////
 
-  Gaia_Source gaia_source;
+  if (catalog_paths.empty ())
+    catalog_paths.push_back ("gaia/data.csv");
+
+  // Replaced as a whole by the watcher; the frame loop takes references to it once per frame.
+  auto live = std::make_shared<Catalog_Snapshot> ();
 
-  if (!gaia_source.load ("gaia/data.csv"))
+  {
+    Reload_Stats stats;
+
+    if (!(watch ? reload_catalog (catalog_paths, Catalog (), live->catalog, stats)
+                : load_catalog (catalog_paths, live->catalog)))
+      {
+        std::cerr << "ERROR: failed to load catalog.\n";
+        return 1;
+      }
+  }
+
+  {
+    const Memory_Usage memory = Memory_Usage::current ();
+
+    std::cerr << "loaded " << live->catalog.size () << " stars; RSS " << (memory.resident >> 20)
+              << " MB, peak " << (memory.peak >> 20) << " MB\n";
+  }
+
+  // Names for catalog stars and other objects, placed over the camera view.
+  Label_Engine star_labels;
+
+  for (const auto &path : label_paths)
+    if (!star_labels.load (path))
+      return 1;
+
+  if (!ephemeris.load ("res/ephemeris.bin"))
     {
-      std::cerr << "ERROR: failed to load CSV.\n";
+      std::cerr << "ERROR: failed to load ephemeris.\n";
       return 1;
     }
 
@@ -468,12 +604,9 @@ main ()
 
   window.setPosition ({ 1920 / 2 - WW / 2, 1080 / 2 - WH / 2 });
 
-  window.setFramerateLimit (FPS);
-
   sf::Mouse::setPosition ({ WW / 2, WH / 2 }, window);
 
-  sf::VertexArray points (sf::Points);
-  sf::VertexArray orbits (sf::Points);
+  sf::VertexArray orbits (sf::Lines);
 
   // glPointSize (2.0f); // Gives stars a better look!
 
@@ -498,9 +631,23 @@ main ()
 
   //////////////////////////////////////////////////////////////////////////////////////////////////
 
-  camera.position.x = t::spatial_unit::from_pc (0);
-  camera.position.y = t::spatial_unit::from_pc (0);
-  camera.position.z = t::spatial_unit::from_pc (0);
+  // Simulation time as a Julian date, starting at the wall clock and clamped to the ephemeris.
+  double jd = 2440587.5 + std::time (nullptr) / 86400.0;
+  double time_rate = 1.0;
+
+  jd = std::clamp (jd, ephemeris.jd_start (), ephemeris.jd_end ());
+
+  const int i_earth = ephemeris.find ("Earth");
+  const int i_moon = ephemeris.find ("Moon");
+
+  std::vector<uint32_t> solar_bodies (ephemeris.size ());
+  std::vector<t::vector3su> solar_positions (ephemeris.size ());
+
+  for (size_t i = 0; i < solar_bodies.size (); ++i)
+    solar_bodies[i] = i;
+
+  if (i_earth >= 0)
+    camera.position = ephemeris.position (i_earth, jd);
 
   camera.focal_length = 8;
 
@@ -510,13 +657,86 @@ main ()
 
   auto camera_speed = t::spatial_unit::from_Mm (300.0);
 
-  std::vector<Body> bodies = gaia_source.to_bodies ();
+  live->index.build (live->catalog);
+
+  live->label_rows = rows_of (live->catalog, star_labels.source_ids ());
+
+  star_labels.resolve (live->label_rows);
+  star_labels.layout (font);
+
+  Catalog_Watcher watcher;
+
+  watcher.label_ids = star_labels.source_ids ();
+
+  if (watch)
+    watcher.start (catalog_paths, live);
+
+  // L cycles the viewport layouts; stereo eyes are one second of travel apart, so the depth
+  // effect follows the scale being flown at.
+  static const char *const LAYOUT_NAMES[LAYOUT_COUNT] = { "single", "split", "stereo", "minimap" };
+
+  View_Layout layout = LAYOUT_SINGLE;
+  Multi_View multi_view;
+  size_t drawn = 0;
+
+  // R toggles refining the single view while it stands still.
+  Progressive_View progressive;
+  bool refine = true;
 
-  points.resize (bodies.size ());
+  Body_Index::Pick picked{ false, 0, 0.0 };
+
+  Query_Stats nearby{ 0, 0.0, 0.0 };
+  const auto nearby_radius = t::spatial_unit::from_pc (50);
+  double pick_ms = 0.0;
+
+  std::vector<Orbit> orbit_set;
+
+  for (size_t i = 0; i < ephemeris.size (); ++i)
+    orbit_set.emplace_back (t::vector3su::ZERO, ephemeris.elements (i),
+                            solar_body_color (ephemeris.name (i)),
+                            (int)i == i_moon ? Orbit::LUNAR : Orbit::SOLAR);
+
+  // Stellar epoch in years after J2016.0, scrubbed with [ and ] at epoch_rate years per second.
+  double epoch = 0.0;
+  double epoch_rate = 1000.0;
 
   bool seeall = false;
   bool orbit_lines = false;
 
+  Quality_Governor governor (target_ms);
+
+  Auto_Exposure auto_exposure;
+  Intensity_Histogram histogram;
+
+  Capture capture (WW, WH, "captures");
+
+  // M cycles the camera view, the galactic-plane map and the all-sky map; N switches the maps
+  // between star counts and luminosity. The texture is only refilled when the map it shows does.
+  enum View_Mode
+  {
+    VIEW_CAMERA,
+    VIEW_PLANE,
+    VIEW_SKY,
+  } view_mode = VIEW_CAMERA;
+
+  bool map_luminosity = false;
+  auto map_extent = t::spatial_unit::from_kpc (2.0);
+
+  Density_Cache density;
+  sf::Texture map_texture;
+  std::vector<uint8_t> map_pixels;
+
+  struct Map_Shown
+  {
+    Density_View view;
+    t::spatial_unit extent;
+    uint64_t revision;
+    bool luminosity;
+  } map_shown{ DENSITY_PLANE, 0, 0, false };
+
+  double map_ms = 0.0;
+  double labels_ms = 0.0;
+
   //////////////////////////////////////////////////////////////////////////////////////////////////
 
   window.setMouseCursorVisible (false);
@@ -526,25 +746,64 @@ main ()
   const sf::Vector2i center (WW / 2, WH / 2);
 
   sf::Mouse::setPosition (center, window);
-  sf::Clock clock, clock_delta;
+  sf::Clock clock;
+
+  Sim_Clock sim_clock;
+  Frame_Pacer pacer (FPS);
+
+  // Simulation state after the last two fixed steps; each frame renders a blend of them.
+  struct Sim_State
+  {
+    t::vector3su position;
+    double jd;
+    double epoch;
+  };
+
+  Sim_State sim{ camera.position, jd, epoch };
+  Sim_State sim_prev = sim;
 
   while (window.isOpen ())
     {
-      float dt = 1.0 / FPS; // clock_delta.restart ().asSeconds ();
+      pacer.wait ();
 
       float start = clock.getElapsedTime ().asSeconds ();
 
+      governor.begin_frame ();
+
+      // A reloaded catalog only takes over here, between frames; rows have moved, so the pick
+      // goes with the old one and labels take their stars' rows found by the watcher.
+      if (watcher.swap (live, epoch))
+        {
+          picked.found = false;
+          star_labels.resolve (live->label_rows);
+        }
+
+      Catalog &catalog = live->catalog;
+      Body_Index &index = live->index;
+
       sf::Event event;
 
       while (window.pollEvent (event))
         switch (event.type)
           {
           case sf::Event::Closed:
+            capture.finish ();
             window.close ();
             break;
 
           case sf::Event::MouseWheelScrolled:
-            if (sf::Mouse::isButtonPressed (sf::Mouse::Right))
+            if (view_mode == VIEW_PLANE)
+              {
+                if (event.mouseWheelScroll.delta > 0)
+                  map_extent /= 2.0;
+
+                if (event.mouseWheelScroll.delta < 0)
+                  map_extent *= 2.0;
+
+                map_extent = std::clamp (map_extent, t::spatial_unit::from_pc (MAP_EXTENT_MIN_PC),
+                                         t::spatial_unit::from_pc (MAP_EXTENT_MAX_PC));
+              }
+            else if (sf::Mouse::isButtonPressed (sf::Mouse::Right))
               {
                 if (event.mouseWheelScroll.delta > 0)
                   camera.focal_length *= 1.1;
@@ -573,6 +832,55 @@ main ()
                 orbit_lines = !orbit_lines;
                 break;
 
+              case sf::Keyboard::G:
+                governor.toggle ();
+                break;
+
+              case sf::Keyboard::M:
+                view_mode = view_mode == VIEW_CAMERA  ? VIEW_PLANE
+                            : view_mode == VIEW_PLANE ? VIEW_SKY
+                                                      : VIEW_CAMERA;
+                break;
+
+              case sf::Keyboard::N:
+                map_luminosity = !map_luminosity;
+                break;
+
+              case sf::Keyboard::L:
+                layout = static_cast<View_Layout> ((layout + 1) % LAYOUT_COUNT);
+                break;
+
+              case sf::Keyboard::E:
+                auto_exposure.enabled = !auto_exposure.enabled;
+                break;
+
+              case sf::Keyboard::R:
+                refine = !refine;
+                break;
+
+              case sf::Keyboard::P:
+                multi_view.psf_enabled = !multi_view.psf_enabled;
+                progressive.reset ();
+                break;
+
+              case sf::Keyboard::F9:
+                log_channel ().level
+                    = static_cast<Log_Level> ((log_channel ().level + 1) % LOG_COUNT);
+                break;
+
+              case sf::Keyboard::F12:
+                capture.screenshot ();
+                break;
+
+              case sf::Keyboard::F11:
+              case sf::Keyboard::F10:
+                if (capture.recording)
+                  capture.stop ();
+                else
+                  capture.start (event.key.code == sf::Keyboard::F11 ? CAPTURE_PNG : CAPTURE_Y4M,
+                                 60.0);
+                break;
+
               case sf::Keyboard::C:
                 camera_speed = t::spatial_unit::from_Mm (300);
                 break;
@@ -581,6 +889,35 @@ main ()
                 camera_speed = t::spatial_unit::from_ly (1.0);
                 break;
 
+              case sf::Keyboard::PageUp:
+                epoch_rate *= 10.0;
+                break;
+
+              case sf::Keyboard::PageDown:
+                epoch_rate /= 10.0;
+                break;
+
+              case sf::Keyboard::Home:
+                sim.epoch = sim_prev.epoch = 0.0;
+                break;
+
+              case sf::Keyboard::Q:
+                nearby = index.query (catalog, Query_Sphere{ camera.position, nearby_radius },
+                                      nullptr);
+                break;
+
+              case sf::Keyboard::Period:
+                time_rate *= 10.0;
+                break;
+
+              case sf::Keyboard::Comma:
+                time_rate /= 10.0;
+                break;
+
+              case sf::Keyboard::Slash:
+                time_rate = 1.0;
+                break;
+
               case sf::Keyboard::Add:
                 if (sf::Keyboard::isKeyPressed (sf::Keyboard::F))
                   camera.f += 0.1;
@@ -604,8 +941,39 @@ main ()
               }
             break;
 
+          case sf::Event::MouseButtonPressed:
+            if (event.mouseButton.button == sf::Mouse::Left)
+              {
+                // The ray goes through the viewport under the cursor, from its own camera.
+                std::vector<Viewport> viewports;
+
+                layout_viewports (layout, camera, camera_speed, viewports);
+
+                const float x = event.mouseButton.x, y = event.mouseButton.y;
+
+                if (const Viewport *viewport = viewport_at (viewports, x, y))
+                  {
+                    const Camera &eye = viewport->camera;
+                    const Projection projection (eye, viewport->width, viewport->height);
+
+                    const auto direction
+                        = projection.unproject (x - viewport->left, y - viewport->top);
+
+                    sf::Clock clock_pick;
+
+                    picked = index.pick (catalog, eye.position, direction, 8.0 / eye.d);
+
+                    pick_ms = clock_pick.getElapsedTime ().asMicroseconds () / 1000.0;
+                  }
+              }
+
+            if (event.mouseButton.button == sf::Mouse::Middle)
+              picked.found = false;
+            break;
+
           case sf::Event::MouseMoved:
-            std::cout << event.mouseMove.x << " " << event.mouseMove.y << std::endl;
+            log_channel ().write (LOG_TRACE, "mouse %d %d", event.mouseMove.x,
+                                  event.mouseMove.y);
             break;
 
           default:
@@ -615,15 +983,87 @@ main ()
       if (camera_speed < 2)
         camera_speed = 2;
 
-      double fov = 2 * atan (36 / (2 * camera.focal_length));
+      const int steps = sim_clock.advance ();
+
+      for (int step = 0; step < steps; ++step)
+        {
+          const double h = Sim_Clock::STEP;
 
-      camera.d = WW / (2.0 * tan (fov / 2.0));
+          sim_prev = sim;
 
-      //////////////////////////////////////////////////////////////////////////////////////////////
+          sim.jd = std::clamp (sim.jd + time_rate * h / 86400.0, ephemeris.jd_start (),
+                               ephemeris.jd_end ());
+
+          if (sf::Keyboard::isKeyPressed (sf::Keyboard::RBracket))
+            sim.epoch += epoch_rate * h;
 
-      auto mouse = sf::Mouse::getPosition (window);
+          if (sf::Keyboard::isKeyPressed (sf::Keyboard::LBracket))
+            sim.epoch -= epoch_rate * h;
 
+          auto &position = sim.position;
+          auto move_speed = camera_speed * h;
+
+          if (sf::Keyboard::isKeyPressed (sf::Keyboard::W))
+            {
+              position.x += std::cos (camera.y) * std::cos (camera.p) * move_speed;
+              position.y += std::sin (camera.y) * std::cos (camera.p) * move_speed;
+              position.z += std::sin (camera.p) * move_speed;
+            }
+
+          if (sf::Keyboard::isKeyPressed (sf::Keyboard::S))
+            {
+              position.x -= std::cos (camera.y) * std::cos (camera.p) * move_speed;
+              position.y -= std::sin (camera.y) * std::cos (camera.p) * move_speed;
+              position.z -= std::sin (camera.p) * move_speed;
+            }
+
+          if (sf::Keyboard::isKeyPressed (sf::Keyboard::D))
+            {
+              position.x += std::cos (camera.y + PI_2) * move_speed;
+              position.y += std::sin (camera.y + PI_2) * move_speed;
+            }
+
+          if (sf::Keyboard::isKeyPressed (sf::Keyboard::A))
+            {
+              position.x -= std::cos (camera.y + PI_2) * move_speed;
+              position.y -= std::sin (camera.y + PI_2) * move_speed;
+            }
+
+          if (sf::Keyboard::isKeyPressed (sf::Keyboard::Space))
+            {
+              position.x += std::cos (camera.y) * -std::sin (camera.p) * move_speed;
+              position.y += std::sin (camera.y) * -std::sin (camera.p) * move_speed;
+              position.z += std::cos (camera.p) * move_speed;
+            }
+
+          if (sf::Keyboard::isKeyPressed (sf::Keyboard::LControl))
+            {
+              position.x -= std::cos (camera.y) * -std::sin (camera.p) * move_speed;
+              position.y -= std::sin (camera.y) * -std::sin (camera.p) * move_speed;
+              position.z -= std::cos (camera.p) * move_speed;
+            }
+        }
+
+      {
+        const double alpha = sim_clock.alpha ();
+
+        camera.position = sim_prev.position + (sim.position - sim_prev.position) * alpha;
+
+        jd = sim_prev.jd + (sim.jd - sim_prev.jd) * alpha;
+        epoch = sim_prev.epoch + (sim.epoch - sim_prev.epoch) * alpha;
+      }
+
+      catalog.propagate (epoch);
+      index.set_epoch (epoch);
+
+      double fov = camera_fov (camera);
+
+      camera.d = camera_distance (camera, WW);
+
+      // Mouse look is read last, right before anything is projected.
       {
+        auto mouse = sf::Mouse::getPosition (window);
+
         double dx = WW / 2.0f - mouse.x;
         double dy = WH / 2.0f - mouse.y;
 
@@ -637,217 +1077,276 @@ main ()
       camera.y = angle_normalize (camera.y);
       camera.p = angle_normalize (camera.p);
 
-      auto move_speed = camera_speed * dt;
-
-      if (sf::Keyboard::isKeyPressed (sf::Keyboard::W))
-        {
-          camera.position.x += std::cos (camera.y) * std::cos (camera.p) * move_speed;
-          camera.position.y += std::sin (camera.y) * std::cos (camera.p) * move_speed;
-          camera.position.z += std::sin (camera.p) * move_speed;
-        }
-
-      if (sf::Keyboard::isKeyPressed (sf::Keyboard::S))
-        {
-          camera.position.x -= std::cos (camera.y) * std::cos (camera.p) * move_speed;
-          camera.position.y -= std::sin (camera.y) * std::cos (camera.p) * move_speed;
-          camera.position.z -= std::sin (camera.p) * move_speed;
-        }
-
-      if (sf::Keyboard::isKeyPressed (sf::Keyboard::D))
-        {
-          camera.position.x += std::cos (camera.y + PI_2) * move_speed;
-          camera.position.y += std::sin (camera.y + PI_2) * move_speed;
-          camera.position.z += 0;
-        }
-
-      if (sf::Keyboard::isKeyPressed (sf::Keyboard::A))
-        {
-          camera.position.x -= std::cos (camera.y + PI_2) * move_speed;
-          camera.position.y -= std::sin (camera.y + PI_2) * move_speed;
-          camera.position.z -= 0;
-        }
+      //////////////////////////////////////////////////////////////////////////////////////////////
 
-      if (sf::Keyboard::isKeyPressed (sf::Keyboard::Space))
-        {
-          camera.position.x += std::cos (camera.y) * -std::sin (camera.p) * move_speed;
-          camera.position.y += std::sin (camera.y) * -std::sin (camera.p) * move_speed;
-          camera.position.z += std::cos (camera.p) * move_speed;
-        }
+      governor.mark (STAGE_UPDATE);
 
-      if (sf::Keyboard::isKeyPressed (sf::Keyboard::LControl))
-        {
-          camera.position.x -= std::cos (camera.y) * -std::sin (camera.p) * move_speed;
-          camera.position.y -= std::sin (camera.y) * -std::sin (camera.p) * move_speed;
-          camera.position.z -= std::cos (camera.p) * move_speed;
-        }
-
-      //////////////////////////////////////////////////////////////////////////////////////////////
+      const Quality quality = governor.quality (multi_view.visible);
 
       window.clear ({ 12, 12, 12 });
 
-#pragma omp parallel for schedule(guided)
-      for (size_t i = 0; i < bodies.size (); ++i)
+      if (view_mode != VIEW_CAMERA)
         {
-          const auto &body = bodies[i];
+          const Density_View view = view_mode == VIEW_PLANE ? DENSITY_PLANE : DENSITY_SKY;
 
-          const auto dx = (camera.position.x - body.position.x).as_AU ();
-          const auto dy = (camera.position.y - body.position.y).as_AU ();
-          const auto dz = (camera.position.z - body.position.z).as_AU ();
+          sf::Clock clock_map;
 
-          const auto L = body.luminosity;
-          const auto D = std::sqrt (dx * dx + dy * dy + dz * dz);
+          const Density_Map &map
+              = view == DENSITY_PLANE
+                    ? density.get (catalog, view, MAP_PLANE_SIZE, MAP_PLANE_SIZE, map_extent)
+                    : density.get (catalog, view, MAP_SKY_WIDTH, MAP_SKY_HEIGHT, map_extent);
 
-          const auto F = 1361.0 * (L / (D * D));
+          const Map_Shown shown{ view, map.extent, map.revision, map_luminosity };
 
-          const auto focal_length = camera.focal_length / 1000;
-          const auto f = camera.f;
-          const auto t = camera.t;
-          const auto iso = camera.iso;
-          const auto N_max = camera.N_photon;
+          if (shown.view != map_shown.view || shown.extent != map_shown.extent
+              || shown.revision != map_shown.revision || shown.luminosity != map_shown.luminosity)
+            {
+              map.colorize (map_luminosity, map_pixels);
 
-          const auto A = PI * std::pow (focal_length / f * 0.5, 2);
+              if (map_texture.getSize () != sf::Vector2u (map.width, map.height))
+                map_texture.create (map.width, map.height);
 
-          const auto E_photon = 6.626e-34 * 3e8 / 550e-9;
-          const auto N_photon = F * A * t / E_photon;
+              map_texture.setSmooth (true);
+              map_texture.update (map_pixels.data ());
 
-          const auto s = iso / 100;
+              map_shown = shown;
+              map_ms = clock_map.getElapsedTime ().asMicroseconds () / 1000.0;
+            }
 
-          auto I = N_photon / N_max * s;
+          draw_density_map (map, map_texture);
 
-          if (seeall)
-            I = 0.4;
+          drawn = 0;
+        }
+      else
+        {
+          const Exposure exposure (camera, seeall);
 
-          auto p = project (camera, body.position);
+          // Only leaves inside the view cones and bright enough to reach one alpha step are
+          // shaded, once for every viewport.
+          const bool metering = auto_exposure.enabled && !seeall;
 
-          sf::Vertex *point = &points[i];
+          layout_viewports (layout, camera, camera_speed, multi_view.viewports);
 
-          if (p.z != 0)
+          // At rest the frame adds the next slice of the full visible set instead, and auto
+          // exposure holds, since a slice is no sample of the whole view.
+          if (refine && layout == LAYOUT_SINGLE
+              && progressive.still (camera, seeall, catalog.revision))
             {
-              point->position.x = p.x;
-              point->position.y = p.y;
-
-              uint8_t r, g, b;
-              applyIntensity_uint8 (255, 115, 60, I, r, g, b);
-              point->color.r = r;
-              point->color.g = g;
-              point->color.b = b;
-              point->color.a = std::min (255.0 * I, 255.0);
+              progressive.refine (catalog, index, multi_view, camera, exposure);
+              progressive.draw (window);
+
+              drawn = progressive.accumulated;
             }
           else
             {
-              point->color.a = 0;
+              progressive.reset ();
+
+              multi_view.render (catalog, index, camera.position, exposure,
+                                 exposure.flux_cutoff () * quality.lod_scale, quality.star_budget,
+                                 metering ? &histogram : nullptr);
+
+              if (!metering)
+                histogram.clear ();
+
+              drawn = multi_view.shaded;
+
+              multi_view.draw (window);
+
+              auto_exposure.update (camera, histogram, pacer.interval);
             }
         }
 
-      window.draw (points, sf::BlendMode (sf::BlendAdd));
+      governor.mark (STAGE_STARS);
+
+      ephemeris.position_batch (solar_bodies.data (), solar_bodies.size (), jd,
+                                solar_positions.data ());
 
-      const auto dx = camera.position.x.as_AU ();
-      const auto dy = camera.position.y.as_AU ();
-      const auto dz = camera.position.z.as_AU ();
-      const auto d_from_zero = std::sqrt (dx * dx + dy * dy + dz * dz);
+      const auto earth = i_earth >= 0 ? solar_positions[i_earth] : t::vector3su::ZERO;
 
-      auto au_from_sun = [] (double au) {
-        return t::spatial_unit::from_AU (1.0) - t::spatial_unit::from_AU (au);
-      };
+      const auto d_from_sun = distance_AU (camera.position, t::vector3su::ZERO);
+      const auto d_from_earth = distance_AU (camera.position, earth);
 
       uint8_t a_solar;
       uint8_t a_moon;
       float fade_solar = 150.0f;
       float fade_moon = 0.01f;
 
-      if (d_from_zero < fade_moon)
+      if (d_from_earth < fade_moon)
         a_moon = 255;
       else
-        a_moon = 255.0 * exp (-(d_from_zero - fade_moon) * 5);
+        a_moon = 255.0 * exp (-(d_from_earth - fade_moon) * 5);
 
-      if (d_from_zero < fade_solar)
+      if (d_from_sun < fade_solar)
         a_solar = 255 - a_moon;
       else
-        a_solar = 255.0 * exp (-(d_from_zero - fade_solar) * 0.03);
-
-      mark_body ("Sun", t::vector3su (au_from_sun (0.000), 0, 0),
-                 sf::Color{ 255, 204, 51, a_solar });
-      mark_body ("Mercury", t::vector3su (au_from_sun (0.387), 0, 0),
-                 sf::Color{ 169, 169, 169, a_solar });
-      mark_body ("Venus", t::vector3su (au_from_sun (0.723), 0, 0),
-                 sf::Color{ 218, 165, 32, a_solar });
-      mark_body ("Mars", t::vector3su (au_from_sun (1.524), 0, 0),
-                 sf::Color{ 188, 39, 50, a_solar });
-      mark_body ("Jupiter", t::vector3su (au_from_sun (5.203), 0, 0),
-                 sf::Color{ 216, 179, 130, a_solar });
-      mark_body ("Saturn", t::vector3su (au_from_sun (9.537), 0, 0),
-                 sf::Color{ 210, 180, 140, a_solar });
-      mark_body ("Uranus", t::vector3su (au_from_sun (19.19), 0, 0),
-                 sf::Color{ 173, 216, 230, a_solar });
-      mark_body ("Neptune", t::vector3su (au_from_sun (30.07), 0, 0),
-                 sf::Color{ 63, 84, 186, a_solar });
-      mark_body ("Pluto", t::vector3su (au_from_sun (39.50), 0, 0),
-                 sf::Color{ 200, 155, 109, a_solar });
-
-      mark_body ("Moon", t::vector3su (au_from_sun (1.00257), 0, 0),
-                 sf::Color{ 128, 128, 128, a_moon });
-      mark_body ("Earth", t::vector3su (au_from_sun (1.000), 0, 0), sf::Color{ 0, 102, 204 });
-
-      if (orbit_lines)
+        a_solar = 255.0 * exp (-(d_from_sun - fade_solar) * 0.03);
+
+      // Overlays are projected for the whole window, so only layouts whose first viewport fills
+      // it get them.
+      const bool overlays
+          = view_mode == VIEW_CAMERA && (layout == LAYOUT_SINGLE || layout == LAYOUT_MINIMAP);
+
+      if (overlays && quality.overlay > 0)
+        {
+          const bool labels = quality.overlay > 1;
+
+          if (labels && !star_labels.labels.empty ())
+            {
+              sf::Clock clock_labels;
+
+              star_labels.place (catalog, index, camera,
+                                 Exposure (camera, seeall).flux_cutoff ());
+              star_labels.draw (window, font);
+
+              labels_ms = clock_labels.getElapsedTime ().asMicroseconds () / 1000.0;
+            }
+
+          mark_body ("Sun", t::vector3su::ZERO, sf::Color{ 255, 204, 51, a_solar }, labels);
+
+          for (size_t i = 0; i < solar_positions.size (); ++i)
+            {
+              sf::Color color = solar_body_color (ephemeris.name (i));
+
+              if ((int)i == i_moon)
+                color.a = a_moon;
+              else if ((int)i != i_earth)
+                color.a = a_solar;
+
+              mark_body (ephemeris.name (i), solar_positions[i], color, labels);
+            }
+        }
+
+      if (overlays && picked.found)
+        {
+          const auto &body = catalog.bodies[picked.index];
+
+          char buffer_distance[64];
+          char buffer_pick[256];
+
+          spatial_unit_as_human (
+              t::spatial_unit::from_AU (distance_AU (body.position, camera.position)),
+              buffer_distance, sizeof buffer_distance);
+
+          snprintf (buffer_pick, sizeof buffer_pick, "Gaia DR3 %ld\n%s\n%.3g L☉",
+                    catalog.source_ids[picked.index], buffer_distance, body.luminosity);
+
+          mark_body (buffer_pick, body.position, sf::Color{ 255, 255, 255 });
+        }
+
+      if (overlays && orbit_lines)
         {
-          t::vector3su sun = { t::spatial_unit::from_AU (1), 0, 0 };
-
-          orbits.clear ();
-
-          circle_around (orbits, sun, t::spatial_unit::from_AU (0.387),
-                         sf::Color{ 169, 169, 169, (uint8_t)(1.0 * a_solar) }, 7.00);
-          circle_around (orbits, sun, t::spatial_unit::from_AU (0.723),
-                         sf::Color{ 218, 165, 32, (uint8_t)(1.0 * a_solar) }, 3.39);
-          circle_around (orbits, sun, t::spatial_unit::from_AU (1.000),
-                         sf::Color{ 0, 102, 204, (uint8_t)(1.0 * a_solar) }, 0.0);
-          circle_around (orbits, sun, t::spatial_unit::from_AU (1.524),
-                         sf::Color{ 188, 39, 50, (uint8_t)(1.0 * a_solar) }, 1.85);
-          circle_around (orbits, sun, t::spatial_unit::from_AU (5.203),
-                         sf::Color{ 216, 179, 130, (uint8_t)(1.0 * a_solar) }, 1.31);
-          circle_around (orbits, sun, t::spatial_unit::from_AU (9.537),
-                         sf::Color{ 210, 180, 140, (uint8_t)(1.0 * a_solar) }, 2.49);
-          circle_around (orbits, sun, t::spatial_unit::from_AU (19.19),
-                         sf::Color{ 173, 216, 230, (uint8_t)(1.0 * a_solar) }, 0.77);
-          circle_around (orbits, sun, t::spatial_unit::from_AU (30.07),
-                         sf::Color{ 63, 84, 186, (uint8_t)(1.0 * a_solar) }, 1.77);
-          circle_around (orbits, sun, t::spatial_unit::from_AU (39.5),
-                         sf::Color{ 200, 155, 109, (uint8_t)(1.0 * a_solar) }, 17.16);
-
-          circle_around (orbits, t::vector3su::ZERO, t::spatial_unit::from_AU (0.00257),
-                         sf::Color{ 128, 128, 128, (uint8_t)(1.0 * a_moon) });
-
-          window.draw (orbits);
+          for (size_t i = 0; i < orbit_set.size (); ++i)
+            {
+              const int center = ephemeris.center (i);
+
+              orbit_set[i].origin = center >= 0 ? solar_positions[center] : t::vector3su::ZERO;
+            }
+
+          draw_orbits (orbits, orbit_set, a_solar, a_moon, quality.orbit_pixels);
         }
+
       //////////////////////////////////////////////////////////////////////////////////////////////
 
-      {
-        sf::CircleShape pointer (1);
+      if (overlays)
+        {
+          sf::CircleShape pointer (1);
 
-        pointer.setPosition ({ WW / 2.0, WH / 2.0 });
-        pointer.setFillColor (sf::Color{ 128, 128, 128 });
+          pointer.setPosition ({ WW / 2.0, WH / 2.0 });
+          pointer.setFillColor (sf::Color{ 128, 128, 128 });
 
-        window.draw (pointer);
-      }
+          window.draw (pointer);
+        }
+
+      governor.mark (STAGE_OVERLAY);
 
       float end = clock.getElapsedTime ().asSeconds ();
 
-      char buffer_ft[512];
+      char buffer_jd[64];
+      jd_to_human (jd, buffer_jd, sizeof buffer_jd);
+
+      char buffer_budget[32];
+
+      if (quality.star_budget > 0)
+        snprintf (buffer_budget, sizeof buffer_budget, "%lu", quality.star_budget);
+      else
+        snprintf (buffer_budget, sizeof buffer_budget, "all");
+
+      char buffer_capture[128] = "";
+
+      if (capture.recording)
+        snprintf (buffer_capture, sizeof buffer_capture,
+                  "capture      = %s %lu frames, %lu dropped, %lu written\n",
+                  capture.format == CAPTURE_PNG ? "png" : "y4m", capture.grabbed,
+                  capture.dropped, capture.written.load ());
+
+      char buffer_map[128] = "";
+
+      if (view_mode != VIEW_CAMERA)
+        {
+          char buffer_extent[64] = "all sky";
+
+          if (view_mode == VIEW_PLANE)
+            spatial_unit_as_human (map_extent, buffer_extent, sizeof buffer_extent);
+
+          snprintf (buffer_map, sizeof buffer_map, "map          = %s, %s, %.2fms\n",
+                    buffer_extent, map_luminosity ? "luminosity" : "counts", map_ms);
+        }
+
+      char buffer_labels[128] = "";
+
+      if (!star_labels.labels.empty ())
+        snprintf (buffer_labels, sizeof buffer_labels, "labels       = %zu / %zu, %.2fms\n",
+                  star_labels.placed, star_labels.candidates.size (), labels_ms);
+
+      char buffer_refine[128] = "";
+
+      if (progressive.active)
+        snprintf (buffer_refine, sizeof buffer_refine,
+                  "refine       = %.0f%%, %zu / %zu stars in %u frames\n",
+                  progressive.total ? 100.0 * progressive.accumulated / progressive.total : 100.0,
+                  progressive.accumulated, progressive.total, progressive.frames);
+      else if (!refine)
+        snprintf (buffer_refine, sizeof buffer_refine, "refine       = off\n");
+
+      char buffer_ft[2048];
 
       snprintf (buffer_ft, sizeof buffer_ft,
 
                 "%6.2fms %8.4f\n"
+                "latency      = %6.2fms\n"
                 "focal_length = %8.1fmm ≈ %6.1f°\n"
                 "f            = %8.1f\n"
-                "t            = %8.1fs\n"
+                "t            = %8.3gs%s\n"
                 "ISO          = %8.0f\n"
 
                 "RA           = %.0f°\n"
-                "DEC          = %.0f°\n",
-
-                1000.0f * (end - start), dt,
-                camera.focal_length, DEG (fov), camera.f, camera.t, camera.iso,
-
-                DEG (camera.y), DEG (camera.p));
+                "DEC          = %.0f°\n"
+                "%s UTC (x%g)\n"
+                "epoch        = J2016.0 %+.0f yr (%g yr/s)\n"
+                "pick         = %8.3fms\n"
+                "50 pc        = %lu stars, %.3g L☉\n"
+                "shaded       = %lu / %lu stars, %s\n"
+                "psf          = %s, Airy disk %.2fpx, %zu sprites\n"
+                "governor     = %s, %.2f / %.1fms\n"
+                "quality      = S%d O%d: lod x%g, budget %s, orbit %gpx, overlay %d\n"
+                "log          = %s, %lu dropped\n"
+                "%s%s%s%s",
+
+                1000.0f * (end - start), pacer.interval, 1000.0 * pacer.latency,
+                camera.focal_length, DEG (fov), camera.f, camera.t,
+                auto_exposure.enabled ? " (auto)" : "", camera.iso,
+
+                DEG (camera.y), DEG (camera.p), buffer_jd, time_rate,
+                epoch, epoch_rate, pick_ms, nearby.count, nearby.luminosity_sum, drawn,
+                catalog.size (), LAYOUT_NAMES[layout],
+                multi_view.psf_enabled ? "on" : "off", multi_view.psf.airy_radius,
+                multi_view.bright_count,
+
+                governor.enabled ? "on" : "off", governor.frame_ms, governor.target_ms,
+                governor.star_level, governor.overlay_level, quality.lod_scale, buffer_budget,
+                quality.orbit_pixels, quality.overlay,
+                log_level_name (log_channel ().level), log_channel ().dropped.load (),
+                buffer_refine, buffer_labels, buffer_map, buffer_capture);
 
       text_ft.setString (cstr_to_sfstr (buffer_ft));
 
@@ -869,9 +1368,20 @@ main ()
 
       window.draw (text_speed);
 
+      governor.mark (STAGE_HUD);
+      governor.end_frame ();
+
+      log_channel ().write (LOG_DEBUG, "frame %.2fms, %lu / %lu stars shaded, S%d O%d",
+                            governor.frame_ms, drawn, catalog.size (), governor.star_level,
+                            governor.overlay_level);
+
       //////////////////////////////////////////////////////////////////////////////////////////////
 
+      capture.grab (clock.getElapsedTime ().asSeconds ());
+
       window.display ();
+
+      pacer.displayed ();
     }
 }
 
@@ -0,0 +1,65 @@
+#include "metering.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void
+Intensity_Histogram::clear ()
+{
+  std::fill (bins, bins + BINS, 0);
+}
+
+uint64_t
+Intensity_Histogram::total () const
+{
+  uint64_t n = 0;
+
+  for (int b = 0; b < BINS; ++b)
+    n += bins[b];
+
+  return n;
+}
+
+double
+Intensity_Histogram::percentile (double p) const
+{
+  const uint64_t n = total ();
+
+  const double rank = p * n;
+
+  uint64_t seen = 0;
+
+  for (int b = 0; b < BINS; ++b)
+    {
+      if (bins[b] > 0 && seen + bins[b] >= rank)
+        {
+          if (b == 0)
+            return 0.0;
+
+          // Spread the bin's stars evenly in log space across its stop.
+          const double within = (rank - seen) / bins[b];
+
+          return std::exp2 (MIN_LOG2 + b - 1 + within);
+        }
+
+      seen += bins[b];
+    }
+
+  return std::exp2 (MIN_LOG2 + BINS - 1);
+}
+
+void
+Auto_Exposure::update (Camera &camera, const Intensity_Histogram &histogram, double dt) const
+{
+  if (!enabled || histogram.total () < min_stars)
+    return;
+
+  const double metered = histogram.percentile (percentile);
+
+  // Nothing measurable at the percentile: open up as fast as allowed.
+  const double error = metered > 0.0 ? std::log2 (target / metered) : max_stops;
+
+  const double stops = std::clamp (error * rate * dt, -max_stops * dt, max_stops * dt);
+
+  camera.t = std::clamp (camera.t * std::exp2 (stops), t_min, t_max);
+}
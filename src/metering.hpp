@@ -0,0 +1,67 @@
+#ifndef METERING_HPP
+#define METERING_HPP
+
+#include <cstdint>
+#include <cstring>
+
+#include "camera.hpp"
+
+// Counts of star intensities in one-stop (power of two) bins. Bin 0 also collects everything
+// fainter than the range, including stars the culling never shaded.
+struct Intensity_Histogram
+{
+  static constexpr int BINS = 64;
+  static constexpr int MIN_LOG2 = -24;
+
+  uint64_t bins[BINS];
+
+  void clear ();
+
+  uint64_t total () const;
+
+  // Reads the binary exponent straight from the float, which is floor(log2) for normal numbers;
+  // zero, denormals and negatives land in bin 0, infinities in the top bin.
+  static int
+  bin (float intensity)
+  {
+    uint32_t bits;
+    std::memcpy (&bits, &intensity, sizeof bits);
+
+    if (bits >> 31)
+      return 0;
+
+    const int b = static_cast<int> (bits >> 23) - 127 - MIN_LOG2 + 1;
+
+    return b < 0 ? 0 : b >= BINS ? BINS - 1 : b;
+  }
+
+  // Intensity below which a fraction `p` of the counted stars fall, interpolated within its bin;
+  // zero when it falls in bin 0.
+  double percentile (double p) const;
+};
+
+// Steers the exposure time so that the given percentile of the stars in view lands on a target
+// intensity. The percentile runs over every star in the view cone, culled ones included, so the
+// metered intensity scales with the exposure and the loop converges.
+struct Auto_Exposure
+{
+  bool enabled{ false };
+
+  double percentile{ 0.999 };
+  double target{ 1.0 };
+
+  // Fraction of the error in stops corrected per second, and the fastest change allowed.
+  double rate{ 3.0 };
+  double max_stops{ 4.0 };
+
+  // Exposure time bounds, in seconds.
+  double t_min{ 1e-6 };
+  double t_max{ 1e4 };
+
+  // Needs at least this many stars in view to meter at all.
+  uint64_t min_stars{ 16 };
+
+  void update (Camera &camera, const Intensity_Histogram &histogram, double dt) const;
+};
+
+#endif // METERING_HPP
@@ -0,0 +1,524 @@
+#include "pack.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+constexpr double LUMINOSITY_STEPS = 512.0;
+constexpr double LUMINOSITY_LOG2_MIN = -40.0;
+
+uint16_t
+quantise_luminosity (double L)
+{
+  if (!(L > 0.0))
+    return 0;
+
+  const double code = std::round ((std::log2 (L) - LUMINOSITY_LOG2_MIN) * LUMINOSITY_STEPS);
+
+  return static_cast<uint16_t> (std::clamp (code, 1.0, 65535.0));
+}
+
+// Decoded luminosity for every code, built once.
+const std::vector<double> &
+luminosity_table ()
+{
+  static const auto table = [] {
+    std::vector<double> t (65536);
+
+    t[0] = 0.0;
+
+    for (size_t code = 1; code < t.size (); ++code)
+      t[code] = std::exp2 (code / LUMINOSITY_STEPS + LUMINOSITY_LOG2_MIN);
+
+    return t;
+  }();
+
+  return table;
+}
+
+uint64_t
+zigzag (int64_t v)
+{
+  return (static_cast<uint64_t> (v) << 1) ^ static_cast<uint64_t> (v >> 63);
+}
+
+int64_t
+unzigzag (uint64_t v)
+{
+  return static_cast<int64_t> (v >> 1) ^ -static_cast<int64_t> (v & 1);
+}
+
+void
+put_varint (std::vector<uint8_t> &out, uint64_t v)
+{
+  while (v >= 0x80)
+    {
+      out.push_back (static_cast<uint8_t> (v) | 0x80);
+      v >>= 7;
+    }
+
+  out.push_back (static_cast<uint8_t> (v));
+}
+
+template <typename T>
+void
+put (std::vector<uint8_t> &out, const T &value)
+{
+  const auto *bytes = reinterpret_cast<const uint8_t *> (&value);
+  out.insert (out.end (), bytes, bytes + sizeof value);
+}
+
+// Bounds-checked cursor over one stream; any overrun clears `ok` and yields zeros.
+struct Reader
+{
+  const uint8_t *p, *end;
+  bool ok;
+
+  uint64_t
+  varint ()
+  {
+    uint64_t v = 0;
+
+    for (int shift = 0; shift < 64 && p < end; shift += 7)
+      {
+        const uint8_t byte = *p++;
+
+        v |= static_cast<uint64_t> (byte & 0x7f) << shift;
+
+        if (!(byte & 0x80))
+          return v;
+      }
+
+    ok = false;
+    return 0;
+  }
+
+  const uint8_t *
+  take (size_t n)
+  {
+    if (static_cast<size_t> (end - p) < n)
+      {
+        ok = false;
+        return nullptr;
+      }
+
+    const uint8_t *at = p;
+    p += n;
+
+    return at;
+  }
+};
+
+// Interleaves the low 21 bits of each coordinate.
+uint64_t
+spread (uint64_t v)
+{
+  v &= 0x1fffff;
+  v = (v | v << 32) & 0x1f00000000ffff;
+  v = (v | v << 16) & 0x1f0000ff0000ff;
+  v = (v | v << 8) & 0x100f00f00f00f00f;
+  v = (v | v << 4) & 0x10c30c30c30c30c3;
+  v = (v | v << 2) & 0x1249249249249249;
+
+  return v;
+}
+
+std::vector<uint32_t>
+morton_order (const Catalog &catalog)
+{
+  const size_t n = catalog.size ();
+
+  int64_t lo[3] = { INT64_MAX, INT64_MAX, INT64_MAX };
+  int64_t hi[3] = { INT64_MIN, INT64_MIN, INT64_MIN };
+
+  for (const auto &p : catalog.epoch_positions)
+    {
+      const int64_t c[3] = { p.x.as_Mm (), p.y.as_Mm (), p.z.as_Mm () };
+
+      for (int a = 0; a < 3; ++a)
+        lo[a] = std::min (lo[a], c[a]), hi[a] = std::max (hi[a], c[a]);
+    }
+
+  double scale = 0.0;
+
+  for (int a = 0; a < 3; ++a)
+    scale = std::max (scale, static_cast<double> (hi[a] - lo[a]));
+
+  scale = scale > 0.0 ? 0x1fffff / scale : 0.0;
+
+  std::vector<std::pair<uint64_t, uint32_t>> keys (n);
+
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; ++i)
+    {
+      const auto &p = catalog.epoch_positions[i];
+
+      const int64_t c[3] = { p.x.as_Mm (), p.y.as_Mm (), p.z.as_Mm () };
+
+      uint64_t key = 0;
+
+      for (int a = 0; a < 3; ++a)
+        key |= spread (static_cast<uint64_t> ((c[a] - lo[a]) * scale)) << a;
+
+      keys[i] = { key, static_cast<uint32_t> (i) };
+    }
+
+  std::sort (keys.begin (), keys.end ());
+
+  std::vector<uint32_t> order (n);
+
+  for (size_t i = 0; i < n; ++i)
+    order[i] = keys[i].second;
+
+  return order;
+}
+
+void
+encode_block (const Catalog &catalog, const uint32_t *order, uint32_t count,
+              std::vector<uint8_t> &out)
+{
+  std::vector<uint8_t> positions, velocities, ids;
+
+  int64_t prev[3] = { 0, 0, 0 };
+  int64_t prev_id = 0;
+
+  for (uint32_t k = 0; k < count; ++k)
+    {
+      const auto i = order[k];
+      const auto &p = catalog.epoch_positions[i];
+      const auto &v = catalog.velocities[i];
+
+      const int64_t c[3] = { p.x.as_Mm (), p.y.as_Mm (), p.z.as_Mm () };
+
+      for (int a = 0; a < 3; ++a)
+        {
+          put_varint (positions, zigzag (c[a] - prev[a]));
+          prev[a] = c[a];
+        }
+
+      put_varint (velocities, zigzag (std::llround (v.x)));
+      put_varint (velocities, zigzag (std::llround (v.y)));
+      put_varint (velocities, zigzag (std::llround (v.z)));
+
+      put_varint (ids, zigzag (catalog.source_ids[i] - prev_id));
+      prev_id = catalog.source_ids[i];
+    }
+
+  put (out, static_cast<uint32_t> (positions.size ()));
+  put (out, static_cast<uint32_t> (velocities.size ()));
+  put (out, static_cast<uint32_t> (ids.size ()));
+
+  out.insert (out.end (), positions.begin (), positions.end ());
+
+  for (uint32_t k = 0; k < count; ++k)
+    put (out, quantise_luminosity (catalog.bodies[order[k]].luminosity));
+
+  out.insert (out.end (), velocities.begin (), velocities.end ());
+
+  for (uint32_t k = 0; k < count; ++k)
+    out.push_back (catalog.colors[order[k]]);
+
+  out.insert (out.end (), ids.begin (), ids.end ());
+}
+
+bool
+decode_block (const uint8_t *data, uint32_t bytes, uint32_t count, size_t first,
+              Catalog &catalog, const std::vector<double> &luminosity)
+{
+  Reader block{ data, data + bytes, true };
+
+  uint32_t sizes[3];
+
+  for (auto &size : sizes)
+    {
+      const uint8_t *at = block.take (sizeof size);
+
+      if (!at)
+        return false;
+
+      std::memcpy (&size, at, sizeof size);
+    }
+
+  const uint8_t *p_positions = block.take (sizes[0]);
+  const uint8_t *p_luminosity = block.take (2 * static_cast<size_t> (count));
+  const uint8_t *p_velocities = block.take (sizes[1]);
+  const uint8_t *p_colors = block.take (count);
+  const uint8_t *p_ids = block.take (sizes[2]);
+
+  if (!block.ok)
+    return false;
+
+  Reader positions{ p_positions, p_positions + sizes[0], true };
+  Reader velocities{ p_velocities, p_velocities + sizes[1], true };
+  Reader ids{ p_ids, p_ids + sizes[2], true };
+
+  int64_t c[3] = { 0, 0, 0 };
+  int64_t id = 0;
+
+  for (uint32_t k = 0; k < count; ++k)
+    {
+      const size_t i = first + k;
+
+      for (auto &axis : c)
+        axis += unzigzag (positions.varint ());
+
+      const t::vector3su position{ t::spatial_unit (c[0]), t::spatial_unit (c[1]),
+                                   t::spatial_unit (c[2]) };
+
+      uint16_t code;
+      std::memcpy (&code, p_luminosity + 2 * k, sizeof code);
+
+      catalog.bodies[i].position = position;
+      catalog.bodies[i].luminosity = luminosity[code];
+      catalog.epoch_positions[i] = position;
+
+      const float vx = unzigzag (velocities.varint ());
+      const float vy = unzigzag (velocities.varint ());
+      const float vz = unzigzag (velocities.varint ());
+
+      catalog.velocities[i] = vector3v (vx, vy, vz);
+      catalog.colors[i] = p_colors[k];
+
+      id += unzigzag (ids.varint ());
+      catalog.source_ids[i] = id;
+    }
+
+  return positions.ok && velocities.ok && ids.ok;
+}
+
+double
+ms_since (std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - start)
+      .count ();
+}
+} // namespace
+
+bool
+is_packed (const std::string &path)
+{
+  std::ifstream file (path, std::ios::binary);
+
+  char magic[4] = {};
+
+  return file.read (magic, sizeof magic) && std::memcmp (magic, "TCAT", 4) == 0;
+}
+
+bool
+save_packed (const std::string &path, const Catalog &catalog, uint32_t block_size)
+{
+  const auto order = morton_order (catalog);
+
+  const uint32_t block_count = (catalog.size () + block_size - 1) / block_size;
+
+  std::vector<std::vector<uint8_t>> blocks (block_count);
+
+#pragma omp parallel for schedule(dynamic)
+  for (uint32_t b = 0; b < block_count; ++b)
+    {
+      const size_t first = static_cast<size_t> (b) * block_size;
+      const auto count
+          = static_cast<uint32_t> (std::min<size_t> (block_size, order.size () - first));
+
+      encode_block (catalog, order.data () + first, count, blocks[b]);
+    }
+
+  Pack_Header header{ { 'T', 'C', 'A', 'T' }, PACK_VERSION, catalog.size (), block_size,
+                      block_count };
+
+  std::vector<Pack_Block> table (block_count);
+
+  uint64_t offset = sizeof header + block_count * sizeof (Pack_Block);
+
+  for (uint32_t b = 0; b < block_count; ++b)
+    {
+      const size_t first = static_cast<size_t> (b) * block_size;
+
+      table[b] = { offset, static_cast<uint32_t> (blocks[b].size ()),
+                   static_cast<uint32_t> (std::min<size_t> (block_size, order.size () - first)) };
+
+      offset += blocks[b].size ();
+    }
+
+  std::ofstream file (path, std::ios::binary);
+
+  if (!file.is_open ())
+    return false;
+
+  file.write (reinterpret_cast<const char *> (&header), sizeof header);
+  file.write (reinterpret_cast<const char *> (table.data ()), table.size () * sizeof (Pack_Block));
+
+  for (const auto &block : blocks)
+    file.write (reinterpret_cast<const char *> (block.data ()), block.size ());
+
+  return file.good ();
+}
+
+bool
+load_packed (const std::string &path, Catalog &catalog)
+{
+  std::ifstream file (path, std::ios::binary | std::ios::ate);
+
+  if (!file.is_open ())
+    return false;
+
+  const auto size = static_cast<size_t> (file.tellg ());
+
+  std::vector<uint8_t> data (size);
+
+  file.seekg (0);
+
+  if (!file.read (reinterpret_cast<char *> (data.data ()), size))
+    return false;
+
+  Pack_Header header;
+
+  if (size < sizeof header)
+    return false;
+
+  std::memcpy (&header, data.data (), sizeof header);
+
+  if (std::memcmp (header.magic, "TCAT", 4) != 0 || header.version != PACK_VERSION
+      || size < sizeof header + header.block_count * sizeof (Pack_Block))
+    return false;
+
+  std::vector<Pack_Block> table (header.block_count);
+
+  std::memcpy (table.data (), data.data () + sizeof header, table.size () * sizeof (Pack_Block));
+
+  // Where each block's stars start in the catalog.
+  std::vector<size_t> first (table.size () + 1, 0);
+
+  for (size_t b = 0; b < table.size (); ++b)
+    {
+      // Written so a crafted offset cannot wrap the sum round. Every star takes at least three
+      // bytes (luminosity and colour), which bounds the counts before the columns are sized.
+      if (table[b].offset > size || table[b].bytes > size - table[b].offset
+          || table[b].count > table[b].bytes / 3)
+        return false;
+
+      first[b + 1] = first[b] + table[b].count;
+    }
+
+  if (first.back () != header.count)
+    return false;
+
+  const size_t n = header.count;
+
+  catalog = Catalog ();
+
+  catalog.bodies.resize (n);
+  catalog.source_ids.resize (n);
+  catalog.epoch_positions.resize (n);
+  catalog.velocities.resize (n);
+  catalog.colors.resize (n);
+
+  const auto &luminosity = luminosity_table ();
+
+  std::atomic<bool> ok{ true };
+
+#pragma omp parallel for schedule(dynamic)
+  for (size_t b = 0; b < table.size (); ++b)
+    if (!decode_block (data.data () + table[b].offset, table[b].bytes, table[b].count, first[b],
+                       catalog, luminosity))
+      ok = false;
+
+  catalog.touch ();
+
+  return ok;
+}
+
+static int
+usage ()
+{
+  std::cerr << "usage: pack INPUT... OUTPUT [--block N]\n";
+  return 1;
+}
+
+int
+pack_main (int argc, char *argv[])
+{
+  std::vector<std::string> paths;
+
+  uint32_t block_size = PACK_BLOCK_SIZE;
+
+  for (int i = 1; i < argc; ++i)
+    {
+      if (std::strcmp (argv[i], "--block") == 0 && i + 1 < argc)
+        {
+          block_size = std::atoi (argv[++i]);
+
+          if (block_size == 0)
+            return usage ();
+        }
+      else if (argv[i][0] == '-')
+        return usage ();
+      else
+        paths.push_back (argv[i]);
+    }
+
+  if (paths.size () < 2)
+    return usage ();
+
+  const std::string output = paths.back ();
+
+  paths.pop_back ();
+
+  Catalog catalog;
+
+  if (!load_catalog (paths, catalog))
+    {
+      std::cerr << "ERROR: failed to load catalog.\n";
+      return 1;
+    }
+
+  const Memory_Usage memory = Memory_Usage::current ();
+
+  auto start = std::chrono::steady_clock::now ();
+
+  if (!save_packed (output, catalog, block_size))
+    {
+      std::cerr << "ERROR: failed to write `" << output << "`.\n";
+      return 1;
+    }
+
+  const double pack_ms = ms_since (start);
+
+  start = std::chrono::steady_clock::now ();
+
+  Catalog check;
+
+  if (!load_packed (output, check) || check.size () != catalog.size ())
+    {
+      std::cerr << "ERROR: `" << output << "` does not read back.\n";
+      return 1;
+    }
+
+  const double load_ms = ms_since (start);
+
+  std::ifstream file (output, std::ios::binary | std::ios::ate);
+
+  const double bytes = file.tellg ();
+  const double n = catalog.size ();
+
+  // What the same columns take in memory, i.e. a raw dump of the catalog.
+  const double raw = n * (sizeof (Body) + sizeof (int64_t) + sizeof (vector3v) + 1);
+
+  std::cerr << "stars          = " << catalog.size () << "\n"
+            << "loaded RSS     = " << (memory.resident >> 20) << " MB (peak " << (memory.peak >> 20)
+            << " MB)\n"
+            << "size           = " << bytes / 1e6 << " MB (" << bytes / n << " B/star, "
+            << raw / bytes << "x smaller than raw columns)\n"
+            << "pack           = " << pack_ms << "ms\n"
+            << "load           = " << load_ms << "ms (" << raw / 1e6 / (load_ms / 1000.0)
+            << " MB/s of raw columns)\n";
+
+  return 0;
+}
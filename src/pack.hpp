@@ -0,0 +1,49 @@
+#ifndef PACK_HPP
+#define PACK_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "catalog.hpp"
+
+// Compressed catalog file. Stars are sorted along a Morton curve and cut into blocks that decode
+// independently; within a block every column is its own stream:
+//
+//   positions     per axis, zigzag varint of the delta (Mm) from the previous star
+//   luminosity    uint16, log2 quantised to 1/512 of a stop (0 for non-positive values)
+//   velocities    per axis, zigzag varint in whole Mm per year
+//   colors        palette index bytes
+//   source_ids    zigzag varint of the delta from the previous star
+//
+// Positions and source ids round-trip exactly. All integers are little-endian.
+struct Pack_Header
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t count;
+  uint32_t block_size;
+  uint32_t block_count;
+};
+
+struct Pack_Block
+{
+  uint64_t offset;
+  uint32_t bytes;
+  uint32_t count;
+};
+
+static constexpr uint32_t PACK_VERSION = 1;
+static constexpr uint32_t PACK_BLOCK_SIZE = 4096;
+
+bool is_packed (const std::string &path);
+
+bool save_packed (const std::string &path, const Catalog &catalog,
+                  uint32_t block_size = PACK_BLOCK_SIZE);
+
+// Reads the whole file, then decodes its blocks in parallel.
+bool load_packed (const std::string &path, Catalog &catalog);
+
+// `pack INPUT... OUTPUT [--block N]`: converts (and merges) anything load_catalog() accepts.
+int pack_main (int argc, char *argv[]);
+
+#endif // PACK_HPP
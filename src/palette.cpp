@@ -0,0 +1,99 @@
+#include "palette.hpp"
+#include "render.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Piecewise Gaussian lobe of the analytic CIE 1931 fit by Wyman, Sloan and Shirley (2013).
+double
+lobe (double lambda, double mu, double s1, double s2)
+{
+  const double t = (lambda - mu) / (lambda < mu ? s1 : s2);
+  return std::exp (-0.5 * t * t);
+}
+
+void
+blackbody_rgb (double teff, float rgb[3])
+{
+  double X = 0.0, Y = 0.0, Z = 0.0;
+
+  for (double lambda = 380.0; lambda <= 780.0; lambda += 5.0)
+    {
+      const double l = lambda * 1e-9;
+      const double B = 1.0 / (std::pow (l, 5) * (std::exp (1.4387769e-2 / (l * teff)) - 1.0));
+
+      X += B
+           * (1.056 * lobe (lambda, 599.8, 37.9, 31.0) + 0.362 * lobe (lambda, 442.0, 16.0, 26.7)
+              - 0.065 * lobe (lambda, 501.1, 20.4, 26.2));
+      Y += B
+           * (0.821 * lobe (lambda, 568.8, 46.9, 40.5) + 0.286 * lobe (lambda, 530.9, 16.3, 31.1));
+      Z += B
+           * (1.217 * lobe (lambda, 437.0, 11.8, 36.0) + 0.681 * lobe (lambda, 459.0, 26.0, 13.8));
+    }
+
+  double r = 3.2406 * X - 1.5372 * Y - 0.4986 * Z;
+  double g = -0.9689 * X + 1.8758 * Y + 0.0415 * Z;
+  double b = 0.0557 * X - 0.2040 * Y + 1.0570 * Z;
+
+  r = std::max (r, 0.0), g = std::max (g, 0.0), b = std::max (b, 0.0);
+
+  const double m = std::max ({ r, g, b });
+
+  rgb[0] = r / m;
+  rgb[1] = g / m;
+  rgb[2] = b / m;
+}
+
+double
+palette_teff (int index)
+{
+  return PALETTE_TEFF_MIN
+         * std::pow (PALETTE_TEFF_MAX / PALETTE_TEFF_MIN, index / (PALETTE_LEGACY - 1.0));
+}
+
+Palette
+make_palette ()
+{
+  Palette palette;
+
+  for (int i = 0; i < PALETTE_LEGACY; ++i)
+    blackbody_rgb (palette_teff (i), palette.rgb[i]);
+
+  palette.rgb[PALETTE_LEGACY][0] = srgb8_to_linear (255);
+  palette.rgb[PALETTE_LEGACY][1] = srgb8_to_linear (115);
+  palette.rgb[PALETTE_LEGACY][2] = srgb8_to_linear (60);
+
+  return palette;
+}
+} // namespace
+
+const Palette &
+star_palette ()
+{
+  static const Palette palette = make_palette ();
+  return palette;
+}
+
+double
+teff_from_bp_rp (double bp_rp)
+{
+  const double c = std::clamp (bp_rp, -0.5, 4.0);
+  const double theta = 0.4929 + 0.5092 * c - 0.0353 * c * c;
+
+  return 5040.0 / theta;
+}
+
+uint8_t
+palette_index (double teff)
+{
+  if (!(teff > 0.0))
+    return PALETTE_LEGACY;
+
+  const double clamped = std::clamp (teff, PALETTE_TEFF_MIN, PALETTE_TEFF_MAX);
+  const double s
+      = std::log (clamped / PALETTE_TEFF_MIN) / std::log (PALETTE_TEFF_MAX / PALETTE_TEFF_MIN);
+
+  return static_cast<uint8_t> (std::lround (s * (PALETTE_LEGACY - 1)));
+}
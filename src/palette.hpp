@@ -0,0 +1,30 @@
+#ifndef PALETTE_HPP
+#define PALETTE_HPP
+
+#include <cstdint>
+
+// Star colours are baked at load into a one-byte index into a fixed palette of pre-linearised
+// blackbody colours, so the per-frame shader only scales a colour by intensity.
+static constexpr int PALETTE_SIZE = 256;
+
+// Entries below this index are blackbodies spaced logarithmically over the temperature range.
+static constexpr uint8_t PALETTE_LEGACY = 255;
+
+static constexpr double PALETTE_TEFF_MIN = 2000.0;
+static constexpr double PALETTE_TEFF_MAX = 40000.0;
+
+struct Palette
+{
+  // Linear sRGB, brightest channel normalised to 1.
+  float rgb[PALETTE_SIZE][3];
+};
+
+const Palette &star_palette ();
+
+// Effective temperature of a dwarf from Gaia BP-RP colour (Mucciarelli & Bellazzini 2020).
+double teff_from_bp_rp (double bp_rp);
+
+// Palette entry for a temperature; PALETTE_LEGACY (the old uniform orange) when unknown.
+uint8_t palette_index (double teff);
+
+#endif // PALETTE_HPP
@@ -0,0 +1,124 @@
+#include "progressive.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+bool
+near (double a, double b, double stops)
+{
+  return a == b || (a > 0 && b > 0 && std::abs (std::log2 (a / b)) <= stops);
+}
+} // namespace
+
+bool
+Progressive_View::still (const Camera &camera, bool seeall, uint64_t revision)
+{
+  const Key key{ camera.position, camera.y,  camera.p, camera.focal_length, camera.f,
+                 camera.t,        camera.iso, seeall,   revision };
+
+  const bool same
+      = have_previous && key.position.x == previous.position.x
+        && key.position.y == previous.position.y && key.position.z == previous.position.z
+        && key.y == previous.y && key.p == previous.p && key.focal_length == previous.focal_length
+        && key.f == previous.f && near (key.t, previous.t, EXPOSURE_TOLERANCE)
+        && near (key.iso, previous.iso, EXPOSURE_TOLERANCE) && key.seeall == previous.seeall
+        && key.revision == previous.revision;
+
+  previous = key;
+  have_previous = true;
+
+  if (!same)
+    reset ();
+
+  return same;
+}
+
+void
+Progressive_View::reset ()
+{
+  active = false;
+  pending.clear ();
+  accumulated = total = 0;
+  frames = 0;
+}
+
+void
+Progressive_View::refine (const Catalog &catalog, const Body_Index &index, Multi_View &view,
+                          const Camera &camera, const Exposure &exposure)
+{
+  if (!active)
+    {
+      const Projection projection (camera);
+
+      index.visible (camera.position,
+                     projection.unproject (projection.half_width, projection.half_height),
+                     projection.half_angle (), exposure.flux_cutoff (), pending);
+
+      total = 0;
+
+      for (const auto &range : pending)
+        total += range.end - range.begin;
+
+      // What the last ordinary frame managed is known to fit in a frame.
+      chunk = std::max (view.shaded, CHUNK_MIN);
+
+      if (accumulation.getSize () != sf::Vector2u (WW, WH))
+        accumulation.create (WW, WH);
+
+      accumulation.clear (sf::Color{ 0, 0, 0, 0 });
+      accumulation.display ();
+
+      active = true;
+    }
+
+  if (pending.empty ())
+    return;
+
+  // Takes `chunk` stars off the back, splitting the last range taken like limit_ranges().
+  view.ranges.clear ();
+
+  size_t taken = 0;
+
+  while (!pending.empty () && taken < chunk)
+    {
+      auto &range = pending.back ();
+
+      const size_t n = range.end - range.begin;
+
+      if (taken + n > chunk)
+        {
+          const uint32_t split = range.end - (chunk - taken);
+
+          view.ranges.push_back ({ split, range.end });
+          range.end = split;
+          taken = chunk;
+        }
+      else
+        {
+          view.ranges.push_back (range);
+          pending.pop_back ();
+          taken += n;
+        }
+    }
+
+  std::reverse (view.ranges.begin (), view.ranges.end ());
+
+  view.shade (catalog, camera.position, exposure, 0, nullptr);
+  view.draw (accumulation);
+
+  accumulation.display ();
+
+  accumulated += taken;
+  frames++;
+}
+
+void
+Progressive_View::draw (sf::RenderTarget &target) const
+{
+  // The texture holds stars already weighted by their alpha, so it is added as it is.
+  sf::Sprite sprite (accumulation.getTexture ());
+
+  target.draw (sprite, sf::BlendMode (sf::BlendMode::One, sf::BlendMode::One));
+}
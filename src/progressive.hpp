@@ -0,0 +1,69 @@
+#ifndef PROGRESSIVE_HPP
+#define PROGRESSIVE_HPP
+
+#include <SFML/Graphics.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "camera.hpp"
+#include "catalog.hpp"
+#include "index.hpp"
+#include "render.hpp"
+#include "views.hpp"
+
+// Refines the star field while the view stands still. Instead of shading the same budgeted set
+// again every frame, each frame adds the next slice of every star the index can see, brightest
+// buckets first and down to the faintest one that reaches one alpha step, into an accumulation
+// texture that the window then shows. Every star is drawn exactly once, so additive blending makes
+// the result the same as one full-catalog frame; once everything is in, a frame costs one textured
+// quad. Any change to the view, the exposure or the catalog starts over.
+struct Progressive_View
+{
+  // Fewest stars added per frame; otherwise as many as the last ordinary frame shaded.
+  static constexpr size_t CHUNK_MIN = 65536;
+
+  // Exposure drift between frames, in stops, that still counts as standing still, so auto
+  // exposure settling does not hold refinement off. It is held while refining.
+  static constexpr double EXPOSURE_TOLERANCE = 1.0 / 64.0;
+
+  // Everything the accumulated image depends on.
+  struct Key
+  {
+    t::vector3su position;
+    double y, p, focal_length;
+    double f, t, iso;
+    bool seeall;
+    uint64_t revision;
+  };
+
+  Key previous{};
+  bool have_previous{ false };
+
+  // Accumulating since the view came to rest.
+  bool active{ false };
+
+  sf::RenderTexture accumulation;
+
+  // Visible ranges still to add, in catalog order, so the brightest are at the back.
+  std::vector<Body_Index::Range> pending;
+
+  size_t chunk{ CHUNK_MIN };
+  size_t accumulated{ 0 }, total{ 0 };
+  uint32_t frames{ 0 };
+
+  // Call once per frame; false, and refinement is dropped, unless the view is the same as in the
+  // previous call. The caller renders as usual then.
+  bool still (const Camera &camera, bool seeall, uint64_t revision);
+
+  void reset ();
+
+  // Adds the next slice through `view`, whose single viewport must already be laid out for
+  // `camera`. The first call after coming to rest collects the visible ranges.
+  void refine (const Catalog &catalog, const Body_Index &index, Multi_View &view,
+               const Camera &camera, const Exposure &exposure);
+
+  void draw (sf::RenderTarget &target) const;
+};
+
+#endif // PROGRESSIVE_HPP
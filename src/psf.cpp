@@ -0,0 +1,154 @@
+#include "psf.hpp"
+#include "common.hpp"
+#include "render.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// First zero of J1, where the first dark ring of the pattern lies.
+constexpr double J1_ZERO = 3.8317;
+
+// Past this, (2 J1(x) / x)² is replaced by its average over a ring, 4 / (π x³); a pixel that far
+// out spans whole rings anyway.
+constexpr double X_EXACT = 40.0;
+
+// Airy intensity at x = π D θ / λ, one at the centre.
+double
+airy (double x)
+{
+  if (x < 1e-6)
+    return 1.0;
+
+  if (x > X_EXACT)
+    return 4.0 / (PI * x * x * x);
+
+  const double j = 2.0 * std::cyl_bessel_j (1.0, x) / x;
+
+  return j * j;
+}
+} // namespace
+
+void
+Psf_Atlas::update (const Camera &camera)
+{
+  const double aperture = camera.focal_length / 1000.0 / camera.f;
+  const double r = 1.22 * WAVELENGTH / aperture * camera.d;
+
+  if (!energy.empty () && std::abs (r / airy_radius - 1.0) <= 0.01)
+    return;
+
+  airy_radius = r;
+
+  // The pattern's x per pixel, and its integral over the plane in square pixels, 4π / a².
+  const double a = J1_ZERO / r;
+  const double norm = a * a / (4.0 * PI) / (SUPERSAMPLING * SUPERSAMPLING);
+
+  energy.assign (CELL * CELL, 0.0f);
+
+  double outside = 0.0;
+
+  for (int dy = -RADIUS_MAX; dy <= RADIUS_MAX; ++dy)
+    for (int dx = -RADIUS_MAX; dx <= RADIUS_MAX; ++dx)
+      {
+        if (dx == 0 && dy == 0)
+          continue;
+
+        double sum = 0.0;
+
+        for (int sy = 0; sy < SUPERSAMPLING; ++sy)
+          for (int sx = 0; sx < SUPERSAMPLING; ++sx)
+            {
+              const double px = dx + (sx + 0.5) / SUPERSAMPLING - 0.5;
+              const double py = dy + (sy + 0.5) / SUPERSAMPLING - 0.5;
+
+              sum += airy (a * std::sqrt (px * px + py * py));
+            }
+
+        energy[(dy + RADIUS_MAX) * CELL + dx + RADIUS_MAX] = sum * norm;
+        outside += sum * norm;
+      }
+
+  // The core is too sharp to sample when the disk is smaller than a pixel, so the star's own
+  // pixel gets whatever light the others did not.
+  energy[RADIUS_MAX * CELL + RADIUS_MAX] = std::max (0.0, 1.0 - outside);
+
+  const uint8_t *srgb = srgb8_table ();
+  const size_t width = LEVELS * CELL;
+
+  pixels.assign (4 * width * CELL, 0);
+
+  for (int level = 0; level < LEVELS; ++level)
+    {
+      const double intensity = std::exp2 (level);
+
+      radius[level] = 0;
+
+      for (int dy = -RADIUS_MAX; dy <= RADIUS_MAX; ++dy)
+        for (int dx = -RADIUS_MAX; dx <= RADIUS_MAX; ++dx)
+          {
+            const double w = intensity * energy[(dy + RADIUS_MAX) * CELL + dx + RADIUS_MAX];
+
+            if (w < VISIBLE_INTENSITY)
+              continue;
+
+            radius[level] = std::max (radius[level], std::max (std::abs (dx), std::abs (dy)));
+
+            // Tone mapped and weighted by alpha like a single point of intensity w.
+            const double tone = w / (1.0 + w);
+            const uint8_t v
+                = srgb[static_cast<int> (tone * (SRGB_TABLE_SIZE - 1))] * std::min (w, 1.0);
+
+            uint8_t *texel
+                = &pixels[4 * ((dy + RADIUS_MAX) * width + level * CELL + dx + RADIUS_MAX)];
+
+            texel[0] = texel[1] = texel[2] = v;
+            texel[3] = 255;
+          }
+    }
+
+  if (texture.getSize () != sf::Vector2u (width, CELL))
+    texture.create (width, CELL);
+
+  texture.update (pixels.data ());
+}
+
+int
+Psf_Atlas::level (double intensity)
+{
+  if (!(intensity >= 1.0))
+    return 0;
+
+  return std::min (static_cast<int> (std::log2 (std::min (intensity, 1e30))), LEVELS - 1);
+}
+
+void
+Psf_Atlas::emit (float x, float y, double intensity, sf::Color color,
+                 std::vector<sf::Vertex> &out) const
+{
+  const int l = level (intensity);
+  const int r = radius[l];
+
+  const float left = std::floor (x) - r, top = std::floor (y) - r;
+  const float side = 2 * r + 1;
+
+  const float u = l * CELL + RADIUS_MAX - r, v = RADIUS_MAX - r;
+
+  sf::Vertex corners[4];
+
+  corners[0].position = { left, top };
+  corners[0].texCoords = { u, v };
+  corners[1].position = { left + side, top };
+  corners[1].texCoords = { u + side, v };
+  corners[2].position = { left, top + side };
+  corners[2].texCoords = { u, v + side };
+  corners[3].position = { left + side, top + side };
+  corners[3].texCoords = { u + side, v + side };
+
+  for (int corner : { 0, 1, 2, 2, 1, 3 })
+    {
+      corners[corner].color = color;
+      out.push_back (corners[corner]);
+    }
+}
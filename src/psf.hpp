@@ -0,0 +1,58 @@
+#ifndef PSF_HPP
+#define PSF_HPP
+
+#include <SFML/Graphics.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "camera.hpp"
+
+// Airy pattern of the camera's lens, prerendered as sprites for a ladder of intensities. The light
+// of a star falls on the pixels around it in fixed fractions that depend only on the size of the
+// Airy disk on screen, which follows from the aperture (focal_length / f) and the pixel scale, so
+// the fractions are worked out once per lens and every level only scales them. A star bright
+// enough to light a whole pixel is drawn with the sprite of its intensity, rounded down to a power
+// of two, so its wings show as far as they stay visible; fainter stars stay single points.
+struct Psf_Atlas
+{
+  // Sprites for intensities 2^0 .. 2^(LEVELS - 1); brighter stars use the last.
+  static constexpr int LEVELS = 24;
+
+  // Largest sprite is (2 RADIUS_MAX + 1) pixels square; every level has a cell that size.
+  static constexpr int RADIUS_MAX = 31;
+  static constexpr int CELL = 2 * RADIUS_MAX + 1;
+
+  static constexpr double WAVELENGTH = 550e-9;
+
+  // Samples per pixel side when integrating the pattern over a pixel.
+  static constexpr int SUPERSAMPLING = 4;
+
+  // Stars at least this intense (1 fully lights a single pixel) are drawn as sprites.
+  static constexpr double THRESHOLD = 1.0;
+
+  // Radius of the first dark ring, in pixels, the sprites were built for.
+  double airy_radius{ 0.0 };
+
+  // Fraction of a star's light landing on each pixel of a cell, centred on the star's pixel.
+  std::vector<float> energy;
+
+  // Half-side of each level's sprite; beyond it the pattern is too faint to show.
+  int radius[LEVELS]{};
+
+  std::vector<uint8_t> pixels;
+  sf::Texture texture;
+
+  // Rebuilds the sprites when the Airy disk of `camera` differs by more than a percent from the
+  // one they were built for.
+  void update (const Camera &camera);
+
+  static int level (double intensity);
+
+  // Appends two triangles drawing a star of `intensity` in `color` centred on the pixel at (x, y).
+  // The texture is premultiplied, for additive blending with sf::BlendMode::One on both sides.
+  void emit (float x, float y, double intensity, sf::Color color,
+             std::vector<sf::Vertex> &out) const;
+};
+
+#endif // PSF_HPP
@@ -0,0 +1,132 @@
+#include "query.hpp"
+#include "catalog.hpp"
+#include "index.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+static int
+usage ()
+{
+  std::cerr << "usage: query sphere X Y Z R [--csv | --bin] [-o PATH] [--catalog PATH]...\n"
+               "       query box X0 Y0 Z0 X1 Y1 Z1 [--csv | --bin] [-o PATH] [--catalog PATH]...\n";
+  return 1;
+}
+
+int
+query_main (int argc, char *argv[])
+{
+  if (argc < 2)
+    return usage ();
+
+  const std::string shape = argv[1];
+  const int arity = shape == "sphere" ? 4 : shape == "box" ? 6 : 0;
+
+  if (arity == 0 || argc < 2 + arity)
+    return usage ();
+
+  std::vector<double> values;
+
+  for (int i = 0; i < arity; ++i)
+    values.push_back (std::atof (argv[2 + i]));
+
+  bool binary = false;
+  std::string output;
+  std::vector<std::string> catalog_paths;
+
+  for (int i = 2 + arity; i < argc; ++i)
+    {
+      if (std::strcmp (argv[i], "--csv") == 0)
+        binary = false;
+      else if (std::strcmp (argv[i], "--bin") == 0)
+        binary = true;
+      else if (std::strcmp (argv[i], "-o") == 0 && i + 1 < argc)
+        output = argv[++i];
+      else if (std::strcmp (argv[i], "--catalog") == 0 && i + 1 < argc)
+        catalog_paths.push_back (argv[++i]);
+      else
+        return usage ();
+    }
+
+  if (catalog_paths.empty ())
+    catalog_paths.push_back ("gaia/data.csv");
+
+  Catalog catalog;
+
+  if (!load_catalog (catalog_paths, catalog))
+    {
+      std::cerr << "ERROR: failed to load catalog.\n";
+      return 1;
+    }
+
+  Body_Index index;
+
+  index.build (catalog);
+
+  std::ofstream file;
+
+  if (!output.empty ())
+    {
+      file.open (output, std::ios::binary);
+
+      if (!file.is_open ())
+        {
+          std::cerr << "ERROR: failed to open " << output << ".\n";
+          return 1;
+        }
+    }
+
+  std::ostream &out = output.empty () ? std::cout : file;
+
+  std::unique_ptr<Query_Sink> sink;
+
+  if (binary)
+    sink = std::make_unique<Query_Binary_Sink> (out);
+  else
+    {
+      out << "source_id,x_pc,y_pc,z_pc,luminosity\n";
+      sink = std::make_unique<Query_Csv_Sink> (out);
+    }
+
+  const auto start = std::chrono::steady_clock::now ();
+
+  Query_Stats stats;
+
+  if (shape == "sphere")
+    {
+      const Query_Sphere sphere{ { t::spatial_unit::from_pc (values[0]),
+                                   t::spatial_unit::from_pc (values[1]),
+                                   t::spatial_unit::from_pc (values[2]) },
+                                 t::spatial_unit::from_pc (values[3]) };
+
+      stats = index.query (catalog, sphere, sink.get ());
+    }
+  else
+    {
+      const Query_Box box{ { t::spatial_unit::from_pc (std::min (values[0], values[3])),
+                             t::spatial_unit::from_pc (std::min (values[1], values[4])),
+                             t::spatial_unit::from_pc (std::min (values[2], values[5])) },
+                           { t::spatial_unit::from_pc (std::max (values[0], values[3])),
+                             t::spatial_unit::from_pc (std::max (values[1], values[4])),
+                             t::spatial_unit::from_pc (std::max (values[2], values[5])) } };
+
+      stats = index.query (catalog, box, sink.get ());
+    }
+
+  out.flush ();
+
+  const auto end = std::chrono::steady_clock::now ();
+
+  fprintf (stderr, "count          = %lu\nluminosity_sum = %.6g\nluminosity_max = %.6g\n"
+                   "time           = %.3fms\n",
+           stats.count, stats.luminosity_sum, stats.luminosity_max,
+           std::chrono::duration<double, std::milli> (end - start).count ());
+
+  return out.good () ? 0 : 1;
+}
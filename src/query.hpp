@@ -0,0 +1,13 @@
+#ifndef QUERY_HPP
+#define QUERY_HPP
+
+// Batch range queries over the catalog, without opening a window:
+//
+//   query sphere X Y Z R [--csv | --bin] [-o PATH] [--catalog PATH]
+//   query box X0 Y0 Z0 X1 Y1 Z1 [--csv | --bin] [-o PATH] [--catalog PATH]
+//
+// Coordinates are in parsecs. Matching bodies are streamed to PATH (stdout by default) and the
+// aggregate statistics are reported on stderr.
+int query_main (int argc, char *argv[]);
+
+#endif // QUERY_HPP
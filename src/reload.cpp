@@ -0,0 +1,181 @@
+#include "reload.hpp"
+#include "log.hpp"
+
+#include <omp.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+
+namespace
+{
+// Wakes the thread this often to notice quit and free retired snapshots.
+constexpr int POLL_TIMEOUT_MS = 100;
+} // namespace
+
+Catalog_Watcher::~Catalog_Watcher ()
+{
+  quit = true;
+
+  if (watcher.joinable ())
+    watcher.join ();
+
+  if (inotify >= 0)
+    close (inotify);
+}
+
+bool
+Catalog_Watcher::start (const std::vector<std::string> &_paths,
+                        std::shared_ptr<Catalog_Snapshot> current)
+{
+  paths = _paths;
+  base = std::move (current);
+
+  inotify = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+
+  if (inotify < 0)
+    {
+      std::cerr << "ERROR: failed to start inotify; catalog changes will not be reloaded.\n";
+      return false;
+    }
+
+  for (const auto &path : paths)
+    {
+      const std::filesystem::path file (path);
+      const std::string directory = file.has_parent_path () ? file.parent_path ().string () : ".";
+
+      // Writes in place end with a close, replacements with a rename into the directory.
+      const int wd = inotify_add_watch (inotify, directory.c_str (), IN_CLOSE_WRITE | IN_MOVED_TO);
+
+      if (wd < 0)
+        {
+          std::cerr << "ERROR: failed to watch `" << directory << "`.\n";
+          return false;
+        }
+
+      watches.push_back (wd);
+      names.push_back (file.filename ().string ());
+    }
+
+  watcher = std::thread (&Catalog_Watcher::run, this);
+
+  return true;
+}
+
+bool
+Catalog_Watcher::swap (std::shared_ptr<Catalog_Snapshot> &current, double _epoch)
+{
+  epoch = _epoch;
+
+  std::lock_guard<std::mutex> lock (mutex);
+
+  // Waits for the watcher to free the last retired snapshot, so this one never drops one itself.
+  if (!ready || retired)
+    return false;
+
+  retired = std::move (current);
+  current = std::move (ready);
+
+  return true;
+}
+
+void
+Catalog_Watcher::reload ()
+{
+  const auto start = std::chrono::steady_clock::now ();
+
+  auto fresh = std::make_shared<Catalog_Snapshot> ();
+
+  Reload_Stats stats;
+
+  if (!reload_catalog (paths, base->catalog, fresh->catalog, stats))
+    {
+      std::cerr << "ERROR: failed to reload catalog; keeping the current one.\n";
+      return;
+    }
+
+  if (stats.changed == 0 && stats.added == 0 && stats.removed == 0)
+    return;
+
+  fresh->catalog.propagate (epoch);
+  fresh->index.build (fresh->catalog);
+  fresh->label_rows = rows_of (fresh->catalog, label_ids);
+
+  std::shared_ptr<Catalog_Snapshot> unused;
+
+  {
+    std::lock_guard<std::mutex> lock (mutex);
+
+    // One that was never picked up is simply replaced.
+    unused = std::move (ready);
+    ready = fresh;
+  }
+
+  base = std::move (fresh);
+
+  const double ms
+      = std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - start)
+            .count ();
+
+  log_channel ().write (LOG_INFO,
+                        "reloaded %zu stars in %.0f ms: %zu changed, %zu added, %zu removed",
+                        base->catalog.size (), ms, stats.changed, stats.added, stats.removed);
+}
+
+void
+Catalog_Watcher::run ()
+{
+  // The render loop keeps to half the cores; reloads get the other half.
+  omp_set_num_threads (std::max (omp_get_num_procs () / 2, 1));
+
+  alignas (inotify_event) char buffer[4096];
+
+  bool pending = false;
+  auto last = std::chrono::steady_clock::now ();
+
+  while (!quit)
+    {
+      pollfd fd{ inotify, POLLIN, 0 };
+
+      if (poll (&fd, 1, POLL_TIMEOUT_MS) > 0)
+        {
+          ssize_t n;
+
+          while ((n = read (inotify, buffer, sizeof buffer)) > 0)
+            for (char *p = buffer; p < buffer + n;)
+              {
+                const auto *event = reinterpret_cast<const inotify_event *> (p);
+
+                for (size_t i = 0; i < watches.size (); ++i)
+                  if (event->wd == watches[i] && event->len > 0 && names[i] == event->name)
+                    {
+                      pending = true;
+                      last = std::chrono::steady_clock::now ();
+                    }
+
+                p += sizeof (inotify_event) + event->len;
+              }
+        }
+
+      {
+        std::shared_ptr<Catalog_Snapshot> old;
+
+        {
+          std::lock_guard<std::mutex> lock (mutex);
+          old = std::move (retired);
+        }
+      }
+
+      if (pending
+          && std::chrono::steady_clock::now () - last
+                 >= std::chrono::milliseconds (SETTLE_MS))
+        {
+          pending = false;
+          reload ();
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef RELOAD_HPP
+#define RELOAD_HPP
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catalog.hpp"
+#include "index.hpp"
+
+// A catalog and what is derived from it, which always change together.
+struct Catalog_Snapshot
+{
+  Catalog catalog;
+  Body_Index index;
+
+  // Rows of Catalog_Watcher::label_ids in `catalog`, found with it so a swap costs nothing more.
+  std::vector<uint32_t> label_rows;
+};
+
+// Reloads the catalog in the background whenever one of its files is rewritten. A thread watches
+// the files' directories with inotify, so a file replaced by a rename is seen as well as one
+// written in place, and waits for the writes to settle. It then reads the files again against the
+// current snapshot (see reload_catalog()), so only new and changed rows are parsed, propagates
+// the result to the epoch on screen, builds its index and finds the labelled stars in it. The
+// render thread picks the new snapshot up between frames with swap(), which only exchanges
+// pointers; the old one is handed back to be freed off the render thread.
+struct Catalog_Watcher
+{
+  // Quiet time after the last write before reloading, in milliseconds.
+  static constexpr int SETTLE_MS = 500;
+
+  std::vector<std::string> paths;
+
+  // Source_ids of the labelled stars, looked up in every reloaded catalog; set before start().
+  std::vector<int64_t> label_ids;
+
+  // Watcher thread state: the snapshot the next reload is compared with, and the watch on each
+  // path's directory with the file name to look for there.
+  std::shared_ptr<Catalog_Snapshot> base;
+  int inotify{ -1 };
+  std::vector<int> watches;
+  std::vector<std::string> names;
+
+  // Shared with the watcher.
+  std::mutex mutex;
+  std::shared_ptr<Catalog_Snapshot> ready;
+  std::shared_ptr<Catalog_Snapshot> retired;
+  std::atomic<double> epoch{ 0.0 };
+  std::atomic<bool> quit{ false };
+
+  std::thread watcher;
+
+  Catalog_Watcher () = default;
+  ~Catalog_Watcher ();
+
+  Catalog_Watcher (const Catalog_Watcher &) = delete;
+  Catalog_Watcher &operator= (const Catalog_Watcher &) = delete;
+
+  // Starts watching `paths`, which `current` was loaded from; false when inotify is unavailable.
+  bool start (const std::vector<std::string> &_paths, std::shared_ptr<Catalog_Snapshot> current);
+
+  // Call between frames with the epoch on screen. Replaces `current` and returns true when a
+  // reload has finished since the last call.
+  bool swap (std::shared_ptr<Catalog_Snapshot> &current, double _epoch);
+
+  void reload ();
+  void run ();
+};
+
+#endif // RELOAD_HPP
@@ -0,0 +1,124 @@
+#include "render.hpp"
+
+#include <fstream>
+
+const uint8_t *
+srgb8_table ()
+{
+  static const auto table = [] {
+    std::vector<uint8_t> t (SRGB_TABLE_SIZE);
+
+    for (int i = 0; i < SRGB_TABLE_SIZE; ++i)
+      t[i] = linear_to_srgb8 ((i + 0.5) / (SRGB_TABLE_SIZE - 1));
+
+    return t;
+  }();
+
+  return table.data ();
+}
+
+Framebuffer::Framebuffer (uint32_t _width, uint32_t _height)
+    : width (_width), height (_height), rgb (3 * static_cast<size_t> (_width) * _height)
+{
+}
+
+void
+Framebuffer::clear (uint8_t r, uint8_t g, uint8_t b)
+{
+  for (size_t i = 0; i < rgb.size (); i += 3)
+    {
+      rgb[i + 0] = r;
+      rgb[i + 1] = g;
+      rgb[i + 2] = b;
+    }
+}
+
+void
+Framebuffer::splat (const Star_Sample &sample)
+{
+  // Checked as floats: a star near the camera plane lands far beyond what the cast can hold.
+  if (sample.a == 0
+      || !(sample.x >= 0 && sample.y >= 0 && sample.x < width && sample.y < height))
+    return;
+
+  const auto x = static_cast<uint32_t> (sample.x);
+  const auto y = static_cast<uint32_t> (sample.y);
+
+  const float a = sample.a / 255.0f;
+
+  float *pixel = &rgb[3 * (static_cast<size_t> (y) * width + x)];
+
+  pixel[0] += sample.r * a;
+  pixel[1] += sample.g * a;
+  pixel[2] += sample.b * a;
+}
+
+void
+Framebuffer::resolve (std::vector<uint8_t> &rgba) const
+{
+  const size_t n = static_cast<size_t> (width) * height;
+
+  rgba.resize (4 * n);
+
+  for (size_t i = 0; i < n; ++i)
+    {
+      rgba[4 * i + 0] = std::min (rgb[3 * i + 0], 255.0f);
+      rgba[4 * i + 1] = std::min (rgb[3 * i + 1], 255.0f);
+      rgba[4 * i + 2] = std::min (rgb[3 * i + 2], 255.0f);
+      rgba[4 * i + 3] = 255;
+    }
+}
+
+void
+Framebuffer::encode_ppm (std::vector<uint8_t> &ppm) const
+{
+  const std::string header
+      = "P6\n" + std::to_string (width) + " " + std::to_string (height) + "\n255\n";
+
+  const size_t n = 3 * static_cast<size_t> (width) * height;
+
+  ppm.resize (header.size () + n);
+
+  std::copy (header.begin (), header.end (), ppm.begin ());
+
+  for (size_t i = 0; i < n; ++i)
+    ppm[header.size () + i] = std::min (rgb[i], 255.0f);
+}
+
+bool
+Framebuffer::write_ppm (const std::string &path) const
+{
+  std::ofstream file (path, std::ios::binary);
+
+  if (!file.is_open ())
+    return false;
+
+  std::vector<uint8_t> ppm;
+
+  encode_ppm (ppm);
+
+  file.write (reinterpret_cast<const char *> (ppm.data ()), ppm.size ());
+
+  return file.good ();
+}
+
+void
+render_stars (const Catalog &catalog, const Body_Index &index, const Camera &camera, bool seeall,
+              Framebuffer &framebuffer)
+{
+  const Projection projection (camera, framebuffer.width, framebuffer.height);
+  const Exposure exposure (camera, seeall);
+
+  std::vector<Body_Index::Range> ranges;
+
+  index.visible (camera.position,
+                 projection.unproject (projection.half_width, projection.half_height),
+                 projection.half_angle (), exposure.flux_cutoff (), ranges);
+
+  Star_Sample sample;
+
+  for (const auto &range : ranges)
+    for (uint32_t i = range.begin; i < range.end; ++i)
+      if (shade_star (projection, exposure, catalog.bodies[i], catalog.colors[i], sample))
+        framebuffer.splat (sample);
+}
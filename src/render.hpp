@@ -0,0 +1,187 @@
+#ifndef RENDER_HPP
+#define RENDER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "camera.hpp"
+#include "catalog.hpp"
+#include "common.hpp"
+#include "index.hpp"
+#include "palette.hpp"
+
+static inline double
+srgb8_to_linear (uint8_t c)
+{
+  const double cs = c / 255.0;
+
+  if (cs <= 0.04045)
+    return cs / 12.92;
+  else
+    return std::pow ((cs + 0.055) / 1.055, 2.4);
+}
+
+static inline uint8_t
+linear_to_srgb8 (double linear)
+{
+  linear = std::max (0.0, linear);
+
+  double srgb;
+
+  if (linear <= 0.0031308)
+    srgb = 12.92 * linear;
+  else
+    srgb = 1.055 * std::pow (linear, 1.0 / 2.4) - 0.055;
+
+  return static_cast<uint8_t> (std::lround (std::clamp (srgb * 255.0, 0.0, 255.0)));
+}
+
+inline void
+applyIntensity_uint8 (uint8_t inR, uint8_t inG, uint8_t inB, double I, uint8_t &outR, uint8_t &outG,
+                      uint8_t &outB)
+{
+  double lr = srgb8_to_linear (inR);
+  double lg = srgb8_to_linear (inG);
+  double lb = srgb8_to_linear (inB);
+
+  lr *= I;
+  lg *= I;
+  lb *= I;
+
+  lr = lr / (1.0 + lr);
+  lg = lg / (1.0 + lg);
+  lb = lb / (1.0 + lb);
+
+  outR = linear_to_srgb8 (lr);
+  outG = linear_to_srgb8 (lg);
+  outB = linear_to_srgb8 (lb);
+}
+
+// linear_to_srgb8 sampled over [0, 1], fine enough that shading needs no pow() per star.
+static constexpr int SRGB_TABLE_SIZE = 8192;
+
+const uint8_t *srgb8_table ();
+
+// Faintest intensity that still survives as a non-zero 8-bit alpha (255 I truncates), halved so
+// rounding in the culling tests can only keep extra stars, never drop visible ones.
+static constexpr double VISIBLE_INTENSITY = 0.5 / 255.0;
+
+// Per-frame photometric constant: a star of luminosity L (in L☉) at D AU from the camera gets
+// intensity k L / D², where k folds in the solar constant, aperture, exposure time and ISO.
+// Also carries the tables the shader reads, so they are looked up once per frame.
+struct Exposure
+{
+  double k;
+  bool seeall;
+
+  const Palette &palette;
+  const uint8_t *srgb;
+
+  Exposure (const Camera &camera, bool _seeall = false)
+      : seeall (_seeall), palette (star_palette ()), srgb (srgb8_table ())
+  {
+    const auto focal_length = camera.focal_length / 1000;
+
+    const auto A = PI * std::pow (focal_length / camera.f * 0.5, 2);
+    const auto E_photon = 6.626e-34 * 3e8 / 550e-9;
+
+    k = 1361.0 * A * camera.t / E_photon / camera.N_photon * (camera.iso / 100);
+  }
+
+  double
+  intensity (double L, double D2) const
+  {
+    return seeall ? 0.4 : k * L / D2;
+  }
+
+  // Apparent flux L / D² (L☉ / AU²) below which a star renders with zero alpha, for
+  // Body_Index::visible(). Recomputed with the exposure, so culling follows f, t and ISO.
+  double
+  flux_cutoff () const
+  {
+    return seeall ? 0.0 : VISIBLE_INTENSITY / k;
+  }
+};
+
+struct Star_Sample
+{
+  float x, y;
+  uint8_t r, g, b, a;
+
+  // Exposure-scaled intensity before tone mapping, for metering.
+  float intensity;
+};
+
+// Scales a pre-linearised palette colour, tone maps it and encodes it through the sRGB table.
+inline void
+shade_color (const Exposure &exposure, uint8_t color, double I, Star_Sample &out)
+{
+  const float *c = exposure.palette.rgb[color];
+  const float i = std::min (I, 1e30);
+
+  const float lr = c[0] * i, lg = c[1] * i, lb = c[2] * i;
+
+  // x / (1 + x), written so that an infinite x maps to 1 instead of NaN.
+  out.r = exposure.srgb[static_cast<int> ((1.0f - 1.0f / (1.0f + lr)) * (SRGB_TABLE_SIZE - 1))];
+  out.g = exposure.srgb[static_cast<int> ((1.0f - 1.0f / (1.0f + lg)) * (SRGB_TABLE_SIZE - 1))];
+  out.b = exposure.srgb[static_cast<int> ((1.0f - 1.0f / (1.0f + lb)) * (SRGB_TABLE_SIZE - 1))];
+}
+
+// Shades one star as a single additive point; false when it is behind the camera.
+inline bool
+shade_star (const Projection &projection, const Exposure &exposure, const Body &body,
+            uint8_t color, Star_Sample &out)
+{
+  const auto dx = (projection.position.x - body.position.x).as_AU ();
+  const auto dy = (projection.position.y - body.position.y).as_AU ();
+  const auto dz = (projection.position.z - body.position.z).as_AU ();
+
+  const auto I = exposure.intensity (body.luminosity, dx * dx + dy * dy + dz * dz);
+
+  const auto p = projection.apply (body.position);
+
+  if (p.z == 0)
+    return false;
+
+  out.x = p.x;
+  out.y = p.y;
+  out.intensity = std::min (I, 1e30);
+
+  shade_color (exposure, color, I, out);
+
+  out.a = std::min (255.0 * I, 255.0);
+
+  return true;
+}
+
+// Software render target that blends like sf::BlendAdd on the window, for off-screen rendering.
+struct Framebuffer
+{
+  uint32_t width, height;
+
+  // Accumulated colour per pixel on a 0-255 scale, clamped on resolve.
+  std::vector<float> rgb;
+
+  Framebuffer (uint32_t _width, uint32_t _height);
+
+  void clear (uint8_t r, uint8_t g, uint8_t b);
+
+  void splat (const Star_Sample &sample);
+
+  // Clamped 8-bit RGBA, ready for sf::Image or an encoder.
+  void resolve (std::vector<uint8_t> &rgba) const;
+
+  // Binary PPM (P6), clamped like resolve().
+  void encode_ppm (std::vector<uint8_t> &ppm) const;
+
+  bool write_ppm (const std::string &path) const;
+};
+
+// Renders every star the index can see from the camera into the framebuffer on the calling thread.
+void render_stars (const Catalog &catalog, const Body_Index &index, const Camera &camera,
+                   bool seeall, Framebuffer &framebuffer);
+
+#endif // RENDER_HPP
@@ -0,0 +1,609 @@
+#include "serve.hpp"
+#include "batch.hpp"
+#include "camera.hpp"
+#include "catalog.hpp"
+#include "common.hpp"
+#include "index.hpp"
+#include "render.hpp"
+
+#include <SFML/Graphics.hpp>
+#include <omp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+// Longest request line accepted, and the largest image side.
+constexpr size_t MAX_LINE = 4096;
+constexpr uint32_t MAX_SIDE = 8192;
+
+// Requests a client may have waiting; past this it is not read from until some are answered.
+constexpr size_t MAX_QUEUED = 64;
+
+// A batch takes at most this many requests, and this many from any one client, taken in turn, so
+// one pipelining client can neither fill it nor make it hold too many images at once. Past
+// MAX_BATCH_PIXELS it stops taking requests, though it always takes one.
+constexpr size_t MAX_BATCH = 32;
+constexpr size_t MAX_BATCH_PER_CLIENT = 4;
+constexpr uint64_t MAX_BATCH_PIXELS = uint64_t (MAX_SIDE) * MAX_SIDE;
+
+// A client holding this many unsent bytes gets no more of its requests rendered until it reads.
+constexpr size_t MAX_UNSENT = size_t (64) << 20;
+
+// A client that makes no progress reading its answers for this long is dropped.
+constexpr int SEND_TIMEOUT_S = 5;
+
+// Wakes the loop this often to notice a stop signal.
+constexpr int POLL_TIMEOUT_MS = 250;
+
+volatile std::sig_atomic_t stopping = 0;
+
+void
+on_signal (int)
+{
+  stopping = 1;
+}
+
+struct Request
+{
+  uint64_t client;
+  uint64_t number;
+  Clock::time_point received;
+
+  Camera camera;
+  uint32_t width, height;
+  bool ppm{ false };
+
+  // Answered with this instead of an image when non-empty.
+  std::string error;
+
+  std::vector<uint8_t> image;
+  double latency_ms{ 0.0 }, render_ms{ 0.0 };
+};
+
+struct Client
+{
+  uint64_t id;
+  int fd;
+
+  // Bytes received after the last complete line.
+  std::string input;
+
+  // Requests read but not yet rendered, in order.
+  std::deque<Request> queued;
+
+  // Answers not yet sent, from `sent` on, and when the client last took any.
+  std::string output;
+  size_t sent{ 0 };
+  Clock::time_point progress;
+
+  // Done sending; closed once everything is answered and sent. Closed right away on errors.
+  bool finished{ false };
+  bool closed{ false };
+
+  size_t
+  unsent () const
+  {
+    return output.size () - sent;
+  }
+};
+
+double
+milliseconds (Clock::duration duration)
+{
+  return std::chrono::duration<double, std::milli> (duration).count ();
+}
+
+void
+parse_request (const std::string &line, Request &request)
+{
+  std::stringstream ss (line);
+
+  if (!read_camera (ss, request.camera))
+    {
+      request.error = "expected x_pc y_pc z_pc yaw_deg pitch_deg focal_length_mm f t iso";
+      return;
+    }
+
+  std::string word;
+
+  while (ss >> word)
+    {
+      uint32_t width, height;
+      char extra;
+
+      if (word == "png")
+        request.ppm = false;
+      else if (word == "ppm")
+        request.ppm = true;
+      else if (std::sscanf (word.c_str (), "%ux%u%c", &width, &height, &extra) == 2 && width
+               && height && width <= MAX_SIDE && height <= MAX_SIDE)
+        {
+          request.width = width;
+          request.height = height;
+        }
+      else
+        {
+          request.error = "unexpected `" + word + "`";
+          return;
+        }
+    }
+
+  request.camera.d = camera_distance (request.camera, request.width);
+}
+
+// Sends what the socket takes without blocking; false when the client is gone.
+bool
+flush (Client &client)
+{
+  while (client.unsent () > 0)
+    {
+      const ssize_t n = send (client.fd, client.output.data () + client.sent, client.unsent (),
+                              MSG_NOSIGNAL | MSG_DONTWAIT);
+
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        break;
+
+      if (n <= 0)
+        return false;
+
+      client.sent += n;
+      client.progress = Clock::now ();
+    }
+
+  if (client.unsent () == 0)
+    {
+      client.output.clear ();
+      client.sent = 0;
+    }
+
+  return true;
+}
+
+// Appends to the client's answers; they go out from the poll loop as the client reads them.
+void
+enqueue (Client &client, const void *data, size_t size)
+{
+  if (client.unsent () == 0)
+    client.progress = Clock::now ();
+
+  client.output.append (static_cast<const char *> (data), size);
+}
+
+// Queues the client's complete lines as requests of `width` x `height` unless they say otherwise;
+// false on errors. A line too long is answered with an error, after which the client is closed. A
+// client that shuts down its end still gets its answers.
+bool
+receive (Client &client, uint32_t width, uint32_t height, uint64_t &requests)
+{
+  char buffer[65536];
+
+  const ssize_t n = recv (client.fd, buffer, sizeof buffer, MSG_DONTWAIT);
+
+  if (n < 0)
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+  if (n == 0)
+    {
+      client.finished = true;
+      return true;
+    }
+
+  client.input.append (buffer, n);
+
+  size_t start = 0, end;
+
+  while ((end = client.input.find ('\n', start)) != std::string::npos)
+    {
+      std::string line = client.input.substr (start, end - start);
+
+      start = end + 1;
+
+      if (!line.empty () && line.back () == '\r')
+        line.pop_back ();
+
+      if (line.find_first_not_of (" \t") == std::string::npos)
+        continue;
+
+      Request request;
+
+      request.client = client.id;
+      request.number = requests++;
+      request.received = Clock::now ();
+      request.width = width;
+      request.height = height;
+
+      parse_request (line, request);
+
+      client.queued.push_back (std::move (request));
+    }
+
+  client.input.erase (0, start);
+
+  if (client.input.size () > MAX_LINE)
+    {
+      const char error[] = "ERROR request too long\n";
+
+      client.input.clear ();
+      client.queued.clear ();
+      client.finished = true;
+
+      enqueue (client, error, sizeof error - 1);
+    }
+
+  return true;
+}
+
+// Takes requests from the clients' queues in turn, within the batch limits, skipping clients
+// that have not read enough of their earlier answers. True when some were left waiting.
+bool
+gather (std::vector<Client> &clients, std::vector<Request> &batch)
+{
+  std::vector<size_t> taken (clients.size (), 0);
+
+  uint64_t pixels = 0;
+  bool more = true;
+
+  while (more && batch.size () < MAX_BATCH)
+    {
+      more = false;
+
+      for (size_t c = 0; c < clients.size () && batch.size () < MAX_BATCH; ++c)
+        {
+          Client &client = clients[c];
+
+          if (client.closed || client.queued.empty () || taken[c] == MAX_BATCH_PER_CLIENT
+              || client.unsent () >= MAX_UNSENT)
+            continue;
+
+          const Request &next = client.queued.front ();
+          const uint64_t size = uint64_t (next.width) * next.height;
+
+          if (!batch.empty () && pixels + size > MAX_BATCH_PIXELS)
+            return true;
+
+          pixels += size;
+          taken[c]++;
+
+          batch.push_back (std::move (client.queued.front ()));
+          client.queued.pop_front ();
+
+          more = true;
+        }
+    }
+
+  for (const Client &client : clients)
+    if (!client.closed && !client.queued.empty () && client.unsent () < MAX_UNSENT)
+      return true;
+
+  return false;
+}
+
+// Every thread renders whole requests into its own framebuffer, kept between batches.
+void
+render_batch (const Catalog &catalog, const Body_Index &index, std::vector<Request> &batch,
+              std::vector<std::unique_ptr<Framebuffer>> &framebuffers)
+{
+#pragma omp parallel
+  {
+    auto &framebuffer = framebuffers[omp_get_thread_num ()];
+
+    std::vector<uint8_t> rgba;
+    sf::Image image;
+
+#pragma omp for schedule(dynamic, 1)
+    for (size_t i = 0; i < batch.size (); ++i)
+      {
+        Request &request = batch[i];
+
+        if (!request.error.empty ())
+          continue;
+
+        const auto start = Clock::now ();
+
+        if (!framebuffer || framebuffer->width != request.width
+            || framebuffer->height != request.height)
+          framebuffer = std::make_unique<Framebuffer> (request.width, request.height);
+
+        framebuffer->clear (12, 12, 12);
+
+        render_stars (catalog, index, request.camera, false, *framebuffer);
+
+        if (request.ppm)
+          framebuffer->encode_ppm (request.image);
+        else
+          {
+            framebuffer->resolve (rgba);
+            image.create (request.width, request.height, rgba.data ());
+
+            if (!image.saveToMemory (request.image, "png"))
+              request.error = "failed to encode image";
+          }
+
+        const auto end = Clock::now ();
+
+        request.render_ms = milliseconds (end - start);
+        request.latency_ms = milliseconds (end - request.received);
+      }
+  }
+}
+
+// Queues the answers of a batch in arrival order and sends what each client takes right away;
+// clients that are gone are closed.
+void
+respond (std::vector<Request> &batch, std::vector<Client> &clients)
+{
+  for (Request &request : batch)
+    {
+      auto client = std::find_if (clients.begin (), clients.end (),
+                                  [&] (const Client &c) { return c.id == request.client; });
+
+      if (client == clients.end () || client->closed)
+        continue;
+
+      std::string header;
+
+      if (request.error.empty ())
+        {
+          char line[128];
+
+          snprintf (line, sizeof line, "OK %zu %.3f %.3f\n", request.image.size (),
+                    request.latency_ms, request.render_ms);
+
+          header = line;
+        }
+      else
+        header = "ERROR " + request.error + "\n";
+
+      enqueue (*client, header.data (), header.size ());
+      enqueue (*client, request.image.data (), request.image.size ());
+
+      // Images can be large; only the bytes still unsent are kept.
+      request.image = std::vector<uint8_t> ();
+
+      if (!flush (*client))
+        client->closed = true;
+
+      if (request.error.empty ())
+        fprintf (stderr, "#%lu %ux%u %s: %.2f ms (render %.2f ms, batch of %zu)\n",
+                 request.number, request.width, request.height, request.ppm ? "ppm" : "png",
+                 request.latency_ms, request.render_ms, batch.size ());
+      else
+        fprintf (stderr, "#%lu: %s\n", request.number, request.error.c_str ());
+    }
+}
+
+int
+usage ()
+{
+  std::cerr << "usage: serve SOCKET [--size WxH] [--catalog PATH]...\n";
+  return 1;
+}
+} // namespace
+
+int
+serve_main (int argc, char *argv[])
+{
+  if (argc < 2)
+    return usage ();
+
+  const std::string path = argv[1];
+
+  uint32_t width = WW, height = WH;
+  std::vector<std::string> catalog_paths;
+
+  for (int i = 2; i < argc; ++i)
+    {
+      if (std::strcmp (argv[i], "--size") == 0 && i + 1 < argc)
+        {
+          if (std::sscanf (argv[++i], "%ux%u", &width, &height) != 2 || !width || !height
+              || width > MAX_SIDE || height > MAX_SIDE)
+            return usage ();
+        }
+      else if (std::strcmp (argv[i], "--catalog") == 0 && i + 1 < argc)
+        catalog_paths.push_back (argv[++i]);
+      else
+        return usage ();
+    }
+
+  sockaddr_un address{};
+
+  address.sun_family = AF_UNIX;
+
+  if (path.empty () || path.size () >= sizeof address.sun_path)
+    {
+      std::cerr << "ERROR: socket path `" << path << "` is too long.\n";
+      return 1;
+    }
+
+  std::memcpy (address.sun_path, path.c_str (), path.size ());
+
+  if (catalog_paths.empty ())
+    catalog_paths.push_back ("gaia/data.csv");
+
+  Catalog catalog;
+
+  if (!load_catalog (catalog_paths, catalog))
+    {
+      std::cerr << "ERROR: failed to load catalog.\n";
+      return 1;
+    }
+
+  Body_Index index;
+
+  index.build (catalog);
+
+  // A socket left behind by an earlier run is replaced; anything else at the path is not touched.
+  struct stat status;
+
+  if (lstat (path.c_str (), &status) == 0)
+    {
+      if (!S_ISSOCK (status.st_mode))
+        {
+          std::cerr << "ERROR: `" << path << "` exists and is not a socket.\n";
+          return 1;
+        }
+
+      unlink (path.c_str ());
+    }
+
+  const int listener = socket (AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+  if (listener < 0 || bind (listener, reinterpret_cast<sockaddr *> (&address), sizeof address) < 0
+      || listen (listener, SOMAXCONN) < 0)
+    {
+      std::cerr << "ERROR: failed to listen on `" << path << "`: " << std::strerror (errno)
+                << "\n";
+
+      if (listener >= 0)
+        close (listener);
+
+      return 1;
+    }
+
+  std::signal (SIGINT, on_signal);
+  std::signal (SIGTERM, on_signal);
+
+  fprintf (stderr, "serving %zu stars on %s with %d thread(s)\n", catalog.size (), path.c_str (),
+           omp_get_max_threads ());
+
+  std::vector<Client> clients;
+  std::vector<pollfd> fds;
+  std::vector<size_t> polled;
+  std::vector<Request> batch;
+  std::vector<std::unique_ptr<Framebuffer>> framebuffers (omp_get_max_threads ());
+
+  uint64_t next_client = 0, requests = 0, served = 0;
+  double total_latency_ms = 0.0;
+
+  // Requests left waiting by the batch limits; the next poll then only looks and goes on.
+  bool waiting = false;
+
+  while (!stopping)
+    {
+      fds.clear ();
+      fds.push_back ({ listener, POLLIN, 0 });
+
+      polled.clear ();
+
+      for (size_t c = 0; c < clients.size (); ++c)
+        {
+          const Client &client = clients[c];
+
+          short events = 0;
+
+          if (!client.finished && client.queued.size () < MAX_QUEUED)
+            events |= POLLIN;
+
+          if (client.unsent () > 0)
+            events |= POLLOUT;
+
+          if (events)
+            {
+              fds.push_back ({ client.fd, events, 0 });
+              polled.push_back (c);
+            }
+        }
+
+      if (poll (fds.data (), fds.size (), waiting ? 0 : POLL_TIMEOUT_MS) < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          std::cerr << "ERROR: poll failed: " << std::strerror (errno) << "\n";
+          break;
+        }
+
+      for (size_t i = 1; i < fds.size (); ++i)
+        {
+          Client &client = clients[polled[i - 1]];
+
+          if ((fds[i].events & POLLIN) && (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+              && !receive (client, width, height, requests))
+            client.closed = true;
+
+          if ((fds[i].revents & (POLLOUT | POLLHUP | POLLERR)) && !client.closed
+              && !flush (client))
+            client.closed = true;
+        }
+
+      if (fds[0].revents & POLLIN)
+        {
+          int fd;
+
+          while ((fd = accept4 (listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+            {
+              clients.emplace_back ();
+              clients.back ().id = next_client++;
+              clients.back ().fd = fd;
+            }
+        }
+
+      waiting = gather (clients, batch);
+
+      if (!batch.empty ())
+        {
+          render_batch (catalog, index, batch, framebuffers);
+          respond (batch, clients);
+
+          for (const Request &request : batch)
+            if (request.error.empty ())
+              {
+                served++;
+                total_latency_ms += request.latency_ms;
+              }
+
+          batch.clear ();
+        }
+
+      const auto now = Clock::now ();
+
+      for (Client &client : clients)
+        {
+          if (client.unsent () > 0
+              && now - client.progress > std::chrono::seconds (SEND_TIMEOUT_S))
+            client.closed = true;
+
+          if (client.closed || (client.finished && client.queued.empty () && client.unsent () == 0))
+            {
+              close (client.fd);
+              client.closed = true;
+            }
+        }
+
+      clients.erase (std::remove_if (clients.begin (), clients.end (),
+                                     [] (const Client &c) { return c.closed; }),
+                     clients.end ());
+    }
+
+  for (const Client &client : clients)
+    close (client.fd);
+
+  close (listener);
+  unlink (path.c_str ());
+
+  fprintf (stderr, "served %lu image(s), mean latency %.2f ms\n", served,
+           served ? total_latency_ms / served : 0.0);
+
+  return 0;
+}
@@ -0,0 +1,26 @@
+#ifndef SERVE_HPP
+#define SERVE_HPP
+
+// Long-running render service on a Unix domain socket, without opening a window:
+//
+//   serve SOCKET [--size WxH] [--catalog PATH]...
+//
+// The catalog and index are loaded once. Clients connect to SOCKET and send one request per line,
+// as many as they like per connection:
+//
+//   x_pc y_pc z_pc yaw_deg pitch_deg focal_length_mm f t iso [WxH] [png | ppm]
+//
+// Each request is answered, in order, with a header line followed by the encoded image:
+//
+//   OK BYTES LATENCY_MS RENDER_MS
+//   ERROR message
+//
+// LATENCY_MS runs from the request being read to its image being encoded. Requests from all
+// clients that arrive while a batch renders make up the next batch, taken from each client in turn
+// up to a limit per client and per batch, and spread across the worker pool; every request is also
+// logged on stderr. Answers are written without blocking as each client reads them, so a client
+// that stops reading holds up only itself, and is dropped once it has made no progress for a few
+// seconds. SIGINT or SIGTERM stops the service and removes the socket.
+int serve_main (int argc, char *argv[]);
+
+#endif // SERVE_HPP
@@ -2,14 +2,6 @@
 
 namespace tachyon
 {
-spatial_unit::spatial_unit (int64_t mm) : m_value (mm) {}
-
-spatial_unit
-spatial_unit::from_Mm (int64_t mm)
-{
-  return spatial_unit (mm);
-}
-
 spatial_unit
 spatial_unit::from_AU (double au)
 {
@@ -34,12 +26,6 @@ spatial_unit::from_kpc (double kpc)
   return spatial_unit (std::round (kpc * KPC));
 }
 
-int64_t
-spatial_unit::as_Mm () const
-{
-  return m_value;
-}
-
 double
 spatial_unit::as_AU () const
 {
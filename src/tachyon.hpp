@@ -55,6 +55,21 @@ public:
   friend spatial_unit operator* (double scalar, const spatial_unit &unit);
 };
 
+// Trivial accessors live here so tight loops over raw Mm values can inline and vectorise.
+inline spatial_unit::spatial_unit (int64_t mm) : m_value (mm) {}
+
+inline spatial_unit
+spatial_unit::from_Mm (int64_t mm)
+{
+  return spatial_unit (mm);
+}
+
+inline int64_t
+spatial_unit::as_Mm () const
+{
+  return m_value;
+}
+
 template <typename T> struct vector3
 {
   static const vector3<T> ZERO;
@@ -0,0 +1,214 @@
+#include "tachyon_ephemeris.hpp"
+#include "tachyon_frame.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace tachyon
+{
+namespace
+{
+struct reader
+{
+  const char *data;
+  size_t size;
+  size_t at{ 0 };
+
+  template <typename T>
+  bool
+  read (T &value)
+  {
+    if (at + sizeof (T) > size)
+      return false;
+
+    std::memcpy (&value, data + at, sizeof (T));
+    at += sizeof (T);
+    return true;
+  }
+};
+
+double
+chebyshev (const float *c, uint32_t degree, double x)
+{
+  double b0 = 0.0, b1 = 0.0;
+
+  for (uint32_t k = degree; k >= 1; --k)
+    {
+      const double b2 = b1;
+      b1 = b0;
+      b0 = 2.0 * x * b1 - b2 + c[k];
+    }
+
+  return x * b0 - b1 + c[0];
+}
+} // namespace
+
+bool
+ephemeris::load (const std::string &path)
+{
+  std::ifstream file (path, std::ios::binary);
+
+  if (!file.is_open ())
+    return false;
+
+  const std::vector<char> buffer ((std::istreambuf_iterator<char> (file)),
+                                  std::istreambuf_iterator<char> ());
+
+  reader r{ buffer.data (), buffer.size () };
+
+  char magic[4];
+  uint32_t version, body_count, reserved;
+
+  if (!r.read (magic) || std::memcmp (magic, "TEPH", 4) != 0)
+    return false;
+
+  if (!r.read (version) || version != 1)
+    return false;
+
+  if (!r.read (body_count) || !r.read (reserved))
+    return false;
+
+  if (!r.read (m_jd_start) || !r.read (m_jd_end))
+    return false;
+
+  m_tables.clear ();
+
+  size_t coefficient_count = 0;
+
+  for (uint32_t i = 0; i < body_count; ++i)
+    {
+      char name[16];
+      table t;
+      uint64_t offset;
+
+      if (!r.read (name) || !r.read (t.center) || !r.read (t.degree)
+          || !r.read (t.interval_count) || !r.read (reserved) || !r.read (t.interval)
+          || !r.read (offset) || !r.read (t.elements.a_AU) || !r.read (t.elements.e)
+          || !r.read (t.elements.i_deg) || !r.read (t.elements.node_deg)
+          || !r.read (t.elements.peri_deg))
+        return false;
+
+      if (t.center >= static_cast<int32_t> (body_count) || t.interval <= 0.0
+          || t.interval_count == 0)
+        return false;
+
+      t.name.assign (name, strnlen (name, sizeof name));
+      t.offset = offset;
+
+      coefficient_count
+          = std::max (coefficient_count, t.offset + 3 * (t.degree + 1) * t.interval_count);
+
+      m_tables.push_back (std::move (t));
+    }
+
+  // position() follows the centers up to the Sun; a chain longer than the table has a cycle.
+  for (uint32_t i = 0; i < body_count; ++i)
+    {
+      uint32_t steps = 0;
+
+      for (int32_t c = m_tables[i].center; c >= 0; c = m_tables[c].center)
+        if (++steps > body_count)
+          {
+            m_tables.clear ();
+            return false;
+          }
+    }
+
+  if (r.size - r.at != coefficient_count * sizeof (float))
+    return false;
+
+  m_coefficients.resize (coefficient_count);
+
+  std::memcpy (m_coefficients.data (), r.data + r.at, coefficient_count * sizeof (float));
+
+  return true;
+}
+
+size_t
+ephemeris::size () const
+{
+  return m_tables.size ();
+}
+
+int
+ephemeris::find (const std::string &name) const
+{
+  for (size_t i = 0; i < m_tables.size (); ++i)
+    if (m_tables[i].name == name)
+      return static_cast<int> (i);
+
+  return -1;
+}
+
+const std::string &
+ephemeris::name (size_t body) const
+{
+  return m_tables[body].name;
+}
+
+int
+ephemeris::center (size_t body) const
+{
+  return m_tables[body].center;
+}
+
+const orbital_elements &
+ephemeris::elements (size_t body) const
+{
+  return m_tables[body].elements;
+}
+
+double
+ephemeris::jd_start () const
+{
+  return m_jd_start;
+}
+
+double
+ephemeris::jd_end () const
+{
+  return m_jd_end;
+}
+
+vector3f
+ephemeris::evaluate_AU (size_t body, double jd) const
+{
+  const auto &t = m_tables[body];
+
+  const double at = (jd - m_jd_start) / t.interval;
+  const double k = std::clamp (std::floor (at), 0.0, t.interval_count - 1.0);
+  const double x = std::clamp (2.0 * (at - k) - 1.0, -1.0, 1.0);
+
+  const uint32_t n = t.degree + 1;
+  const float *c = m_coefficients.data () + t.offset + 3 * n * static_cast<size_t> (k);
+
+  return vector3f (chebyshev (c, t.degree, x), chebyshev (c + n, t.degree, x),
+                   chebyshev (c + 2 * n, t.degree, x));
+}
+
+vector3su
+ephemeris::position (size_t body, double jd) const
+{
+  static const rotation3 to_icrs = frame_rotation (frame::ecliptic, frame::icrs);
+
+  vector3f p = evaluate_AU (body, jd);
+
+  for (int c = m_tables[body].center; c >= 0; c = m_tables[c].center)
+    p += evaluate_AU (c, jd);
+
+  p = to_icrs.apply (p);
+
+  return vector3su (spatial_unit::from_AU (p.x), spatial_unit::from_AU (p.y),
+                    spatial_unit::from_AU (p.z));
+}
+
+void
+ephemeris::position_batch (const uint32_t *bodies, size_t n, double jd, vector3su *out) const
+{
+#pragma omp parallel for schedule(static) if (n > 1024)
+  for (size_t i = 0; i < n; ++i)
+    out[i] = position (bodies[i], jd);
+}
+} // namespace tachyon
@@ -0,0 +1,73 @@
+#ifndef TACHYON_EPHEMERIS_HPP
+#define TACHYON_EPHEMERIS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "tachyon.hpp"
+
+namespace tachyon
+{
+// Mean J2000 orbital elements relative to the body's center, used for drawing orbits.
+struct orbital_elements
+{
+  double a_AU{ 0 };
+  double e{ 0 };
+  double i_deg{ 0 };
+  double node_deg{ 0 };
+  double peri_deg{ 0 };
+};
+
+// Solar-system ephemeris backed by piecewise Chebyshev tables (see tools/ephemeris.py).
+// Positions are heliocentric and rotated into the equatorial frame the star catalog uses. The
+// coefficients are stored as float32, so they are good to about 1e-7 of a body's distance: a few
+// km for the inner planets, up to some 200 km for Neptune and Pluto.
+class ephemeris
+{
+private:
+  struct table
+  {
+    std::string name;
+    int32_t center;
+    uint32_t degree;
+    uint32_t interval_count;
+    double interval;
+    size_t offset;
+    orbital_elements elements;
+  };
+
+  double m_jd_start{ 0 };
+  double m_jd_end{ 0 };
+
+  std::vector<table> m_tables;
+  std::vector<float> m_coefficients;
+
+  vector3f evaluate_AU (size_t body, double jd) const;
+
+public:
+  static constexpr double J2000 = 2451545.0;
+  static constexpr double OBLIQUITY_DEG = 23.4392911;
+
+  ephemeris () = default;
+
+  bool load (const std::string &path);
+
+  size_t size () const;
+  int find (const std::string &name) const;
+
+  const std::string &name (size_t body) const;
+  int center (size_t body) const;
+  const orbital_elements &elements (size_t body) const;
+
+  double jd_start () const;
+  double jd_end () const;
+
+  vector3su position (size_t body, double jd) const;
+
+  void position_batch (const uint32_t *bodies, size_t n, double jd, vector3su *out) const;
+};
+} // namespace tachyon
+
+#endif // TACHYON_EPHEMERIS_HPP
@@ -0,0 +1,184 @@
+#include "tachyon_frame.hpp"
+
+#include <algorithm>
+
+namespace tachyon
+{
+namespace
+{
+constexpr rotation3 IDENTITY{ {
+    { 1.0, 0.0, 0.0 },
+    { 0.0, 1.0, 0.0 },
+    { 0.0, 0.0, 1.0 },
+} };
+
+// Batches smaller than this are not worth waking the other threads for. The loops' if clauses name
+// `parallel`, since an unnamed one would turn off vectorisation as well.
+constexpr size_t PARALLEL_MIN = 65536;
+
+const rotation3 &
+from_icrs (frame to)
+{
+  switch (to)
+    {
+    case frame::galactic:
+      return ICRS_TO_GALACTIC;
+    case frame::ecliptic:
+      return ICRS_TO_ECLIPTIC;
+    default:
+      return IDENTITY;
+    }
+}
+
+// Nearest Mm; a plain conversion, unlike llround(), so the loops vectorise.
+inline spatial_unit
+to_unit (double mm)
+{
+  return spatial_unit (static_cast<int64_t> (mm < 0 ? mm - 0.5 : mm + 0.5));
+}
+} // namespace
+
+vector3f
+rotation3::apply (const vector3f &v) const
+{
+  return vector3f (m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+                   m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+                   m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z);
+}
+
+rotation3
+rotation3::transpose () const
+{
+  rotation3 t;
+
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j)
+      t.m[i][j] = m[j][i];
+
+  return t;
+}
+
+rotation3
+rotation3::operator* (const rotation3 &other) const
+{
+  rotation3 r;
+
+  for (int i = 0; i < 3; ++i)
+    for (int j = 0; j < 3; ++j)
+      r.m[i][j] = m[i][0] * other.m[0][j] + m[i][1] * other.m[1][j] + m[i][2] * other.m[2][j];
+
+  return r;
+}
+
+rotation3
+frame_rotation (frame from, frame to)
+{
+  if (from == to)
+    return IDENTITY;
+
+  return from_icrs (to) * from_icrs (from).transpose ();
+}
+
+vector3su
+to_cartesian (const spherical &s)
+{
+  const double d = s.distance.as_Mm ();
+  const double c = std::cos (s.lat);
+
+  return vector3su (to_unit (d * c * std::cos (s.lon)), to_unit (d * c * std::sin (s.lon)),
+                    to_unit (d * std::sin (s.lat)));
+}
+
+spherical
+to_spherical (const vector3su &p)
+{
+  const double x = p.x.as_Mm (), y = p.y.as_Mm (), z = p.z.as_Mm ();
+
+  const double lon = std::atan2 (y, x);
+
+  return spherical{ lon < 0 ? lon + 2 * M_PI : lon, std::atan2 (z, std::sqrt (x * x + y * y)),
+                    to_unit (std::sqrt (x * x + y * y + z * z)) };
+}
+
+vector3su
+rotate (const rotation3 &r, const vector3su &p)
+{
+  const double x = p.x.as_Mm (), y = p.y.as_Mm (), z = p.z.as_Mm ();
+
+  return vector3su (to_unit (r.m[0][0] * x + r.m[0][1] * y + r.m[0][2] * z),
+                    to_unit (r.m[1][0] * x + r.m[1][1] * y + r.m[1][2] * z),
+                    to_unit (r.m[2][0] * x + r.m[2][1] * y + r.m[2][2] * z));
+}
+
+void
+transform_batch (frame from, frame to, const vector3su *in, size_t n, vector3su *out)
+{
+  if (from == to)
+    {
+      if (in != out)
+        std::copy (in, in + n, out);
+
+      return;
+    }
+
+  const rotation3 r = frame_rotation (from, to);
+
+  // Component by component: vector3's assignment operator checks for self-assignment, which keeps
+  // the loop from vectorising.
+#pragma omp parallel for simd schedule(static) if (parallel : n > PARALLEL_MIN)
+  for (size_t i = 0; i < n; ++i)
+    {
+      const double x = in[i].x.as_Mm (), y = in[i].y.as_Mm (), z = in[i].z.as_Mm ();
+
+      out[i].x = to_unit (r.m[0][0] * x + r.m[0][1] * y + r.m[0][2] * z);
+      out[i].y = to_unit (r.m[1][0] * x + r.m[1][1] * y + r.m[1][2] * z);
+      out[i].z = to_unit (r.m[2][0] * x + r.m[2][1] * y + r.m[2][2] * z);
+    }
+}
+
+void
+to_spherical_batch (frame from, frame to, const vector3su *in, size_t n, spherical *out)
+{
+  const rotation3 r = frame_rotation (from, to);
+
+#pragma omp parallel for simd schedule(static) if (parallel : n > PARALLEL_MIN)
+  for (size_t i = 0; i < n; ++i)
+    {
+      const double x0 = in[i].x.as_Mm (), y0 = in[i].y.as_Mm (), z0 = in[i].z.as_Mm ();
+
+      const double x = r.m[0][0] * x0 + r.m[0][1] * y0 + r.m[0][2] * z0;
+      const double y = r.m[1][0] * x0 + r.m[1][1] * y0 + r.m[1][2] * z0;
+      const double z = r.m[2][0] * x0 + r.m[2][1] * y0 + r.m[2][2] * z0;
+
+      const double lon = std::atan2 (y, x);
+      const double rho2 = x * x + y * y;
+
+      out[i].lon = lon < 0 ? lon + 2 * M_PI : lon;
+      out[i].lat = std::atan2 (z, std::sqrt (rho2));
+      out[i].distance = to_unit (std::sqrt (rho2 + z * z));
+    }
+}
+
+void
+to_cartesian_batch (frame from, frame to, const spherical *in, size_t n, vector3su *out)
+{
+  const rotation3 r = frame_rotation (from, to);
+
+#pragma omp parallel for simd schedule(static) if (parallel : n > PARALLEL_MIN)
+  for (size_t i = 0; i < n; ++i)
+    {
+      // Cosines as shifted sines: a sin() and cos() of one angle are merged into a sincos() call,
+      // which has no vector version.
+      const double d = in[i].distance.as_Mm ();
+      const double c = std::sin (in[i].lat + M_PI_2);
+
+      const double x = d * c * std::sin (in[i].lon + M_PI_2);
+      const double y = d * c * std::sin (in[i].lon);
+      const double z = d * std::sin (in[i].lat);
+
+      out[i].x = to_unit (r.m[0][0] * x + r.m[0][1] * y + r.m[0][2] * z);
+      out[i].y = to_unit (r.m[1][0] * x + r.m[1][1] * y + r.m[1][2] * z);
+      out[i].z = to_unit (r.m[2][0] * x + r.m[2][1] * y + r.m[2][2] * z);
+    }
+}
+} // namespace tachyon
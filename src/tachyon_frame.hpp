@@ -0,0 +1,71 @@
+#ifndef TACHYON_FRAME_HPP
+#define TACHYON_FRAME_HPP
+
+#include <cstddef>
+
+#include "tachyon.hpp"
+
+namespace tachyon
+{
+// Heliocentric reference frames. Positions in the catalog and from the ephemeris are ICRS.
+enum class frame
+{
+  icrs,
+  galactic,
+  ecliptic,
+};
+
+// Rotation matrix; rows are the target frame's axes in the source frame.
+struct rotation3
+{
+  double m[3][3];
+
+  vector3f apply (const vector3f &v) const;
+
+  rotation3 transpose () const;
+
+  // This rotation after `other`.
+  rotation3 operator* (const rotation3 &other) const;
+};
+
+// ICRS to galactic (Hipparcos, ESA 1997): towards the Galactic Centre, towards l = 90°, and
+// towards the north galactic pole.
+inline constexpr rotation3 ICRS_TO_GALACTIC{ {
+    { -0.0548755604162154, -0.8734370902348850, -0.4838350155487132 },
+    { +0.4941094278755837, -0.4448296299600112, +0.7469822444972189 },
+    { -0.8676661490190047, -0.1980763734312015, +0.4559837761750669 },
+} };
+
+// ICRS to the mean ecliptic of J2000, a turn about the x axis by the obliquity (see
+// ephemeris::OBLIQUITY_DEG).
+inline constexpr rotation3 ICRS_TO_ECLIPTIC{ {
+    { 1.0, 0.0, 0.0 },
+    { 0.0, +0.917482062146321, +0.39777715575399053 },
+    { 0.0, -0.39777715575399053, +0.917482062146321 },
+} };
+
+rotation3 frame_rotation (frame from, frame to);
+
+// Longitude in [0, 2π) and latitude in [-π/2, π/2], in radians, as right ascension and
+// declination are in ICRS.
+struct spherical
+{
+  double lon;
+  double lat;
+  spatial_unit distance;
+};
+
+vector3su to_cartesian (const spherical &s);
+spherical to_spherical (const vector3su &p);
+
+vector3su rotate (const rotation3 &r, const vector3su &p);
+
+// Batch transforms between frames, split across threads for large batches. `in` and `out` may be
+// the same array.
+void transform_batch (frame from, frame to, const vector3su *in, size_t n, vector3su *out);
+
+void to_spherical_batch (frame from, frame to, const vector3su *in, size_t n, spherical *out);
+void to_cartesian_batch (frame from, frame to, const spherical *in, size_t n, vector3su *out);
+} // namespace tachyon
+
+#endif // TACHYON_FRAME_HPP
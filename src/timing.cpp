@@ -0,0 +1,84 @@
+#include "timing.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace
+{
+// Per-frame weight of a latency sample above and below the current estimate: quick to back off
+// after a slow frame, slow to trust a fast one.
+constexpr double LATENCY_RISE = 0.5;
+constexpr double LATENCY_DECAY = 0.05;
+
+double
+seconds (std::chrono::steady_clock::duration d)
+{
+  return std::chrono::duration<double> (d).count ();
+}
+} // namespace
+
+Sim_Clock::Sim_Clock () : last (clock::now ()) {}
+
+int
+Sim_Clock::advance ()
+{
+  const auto now = clock::now ();
+
+  elapsed = std::min (seconds (now - last), MAX_ELAPSED);
+  last = now;
+
+  accumulator += elapsed;
+
+  const int steps = static_cast<int> (accumulator / STEP);
+
+  accumulator -= steps * STEP;
+
+  return steps;
+}
+
+double
+Sim_Clock::alpha () const
+{
+  return std::clamp (accumulator / STEP, 0.0, 1.0);
+}
+
+Frame_Pacer::Frame_Pacer (double fps)
+    : period (1.0 / fps), woke (clock::now ()), shown (clock::now ()), target (clock::now ())
+{
+}
+
+void
+Frame_Pacer::wait ()
+{
+  const auto ahead = [] (double s) {
+    return std::chrono::duration_cast<clock::duration> (std::chrono::duration<double> (s));
+  };
+
+  const auto now = clock::now ();
+
+  // Stay on the ideal schedule so early frames don't drift it; re-anchor after a missed one.
+  target += ahead (period);
+
+  if (target < now + ahead (latency))
+    target = now + ahead (latency);
+
+  const auto wake = target - ahead (latency + SLACK);
+
+  if (wake > now)
+    std::this_thread::sleep_until (wake);
+
+  woke = clock::now ();
+}
+
+void
+Frame_Pacer::displayed ()
+{
+  const auto now = clock::now ();
+
+  const double sample = seconds (now - woke);
+
+  latency += (sample - latency) * (sample > latency ? LATENCY_RISE : LATENCY_DECAY);
+
+  interval = seconds (now - shown);
+  shown = now;
+}
@@ -0,0 +1,67 @@
+#ifndef TIMING_HPP
+#define TIMING_HPP
+
+#include <chrono>
+
+// Fixed-step simulation clock. Real time accumulates and is consumed in STEP-sized slices, so
+// motion integrates the same way however long frames take; the remainder is the fraction of a
+// step to interpolate the last two states by.
+struct Sim_Clock
+{
+  static constexpr double STEP = 1.0 / 240.0;
+
+  // Longest real interval one frame may account for, so a stall doesn't queue up a burst of steps.
+  static constexpr double MAX_ELAPSED = 0.25;
+
+  using clock = std::chrono::steady_clock;
+
+  clock::time_point last;
+  double accumulator{ 0.0 };
+
+  // Real seconds covered by the latest advance().
+  double elapsed{ 0.0 };
+
+  Sim_Clock ();
+
+  // Number of steps to run for the real time since the previous call.
+  int advance ();
+
+  // How far between the previous and the latest step the frame is, in [0, 1).
+  double alpha () const;
+};
+
+// Paces frames to a display period without sleeping inside display(). Instead of sleeping after
+// the frame is submitted, it sleeps before input is read, by as much as the measured
+// input-to-display latency allows, so every frame is built from the freshest input possible.
+struct Frame_Pacer
+{
+  // Safety margin on top of the latency estimate, in seconds.
+  static constexpr double SLACK = 0.0005;
+
+  using clock = std::chrono::steady_clock;
+
+  double period;
+
+  // Smoothed input-to-display time, in seconds.
+  double latency{ 0.0 };
+
+  // Latest display-to-display interval, in seconds.
+  double interval{ 0.0 };
+
+  clock::time_point woke;
+  clock::time_point shown;
+
+  // When the frame being built should reach the display.
+  clock::time_point target;
+
+  Frame_Pacer (double fps);
+
+  // Sleeps until the latest moment the next frame can start and still be on time, then marks
+  // the start of input handling.
+  void wait ();
+
+  // Call right after display().
+  void displayed ();
+};
+
+#endif // TIMING_HPP
@@ -0,0 +1,366 @@
+#include "views.hpp"
+#include "common.hpp"
+#include "governor.hpp"
+
+#include <omp.h>
+
+#include <algorithm>
+
+namespace
+{
+// Inset size as a fraction of the window, and its margin in pixels.
+constexpr float INSET_SCALE = 0.25f;
+constexpr float INSET_MARGIN = 10.0f;
+
+Viewport &
+set_viewport (Viewport &viewport, const Camera &camera, float left, float top, float width,
+              float height, bool inset = false)
+{
+  viewport.camera = camera;
+  viewport.camera.d = camera_distance (camera, width);
+  viewport.left = left;
+  viewport.top = top;
+  viewport.width = width;
+  viewport.height = height;
+  viewport.inset = inset;
+
+  return viewport;
+}
+
+// Projects stars, given by their offset (Mm) from the shared origin, into a viewport. Loops take a
+// private copy, so it is not reloaded after every vertex store.
+struct Placement
+{
+  Projection projection;
+
+  // Where the viewport's camera sits relative to the origin, in Mm.
+  double shift_x, shift_y, shift_z;
+
+  float left, top, width, height;
+
+  Placement (const Viewport &viewport, const t::vector3su &origin)
+      : projection (viewport.camera, viewport.width, viewport.height), left (viewport.left),
+        top (viewport.top), width (viewport.width), height (viewport.height)
+  {
+    const auto shift = viewport.camera.position - origin;
+
+    shift_x = shift.x.as_Mm ();
+    shift_y = shift.y.as_Mm ();
+    shift_z = shift.z.as_Mm ();
+  }
+
+  // Stars that miss the rectangle or are behind the camera get zero alpha; false when behind.
+  bool
+  place (double x, double y, double z, sf::Color color, sf::Vertex &point) const
+  {
+    const auto p = projection.screen (projection.rotate (x - shift_x, y - shift_y, z - shift_z));
+
+    if (p.z == 0 || !(p.x >= 0 && p.y >= 0 && p.x < width && p.y < height))
+      color.a = 0;
+
+    point.position.x = left + p.x;
+    point.position.y = top + p.y;
+    point.color = color;
+
+    return p.z != 0;
+  }
+};
+} // namespace
+
+void
+layout_viewports (View_Layout layout, const Camera &camera, t::spatial_unit baseline,
+                  std::vector<Viewport> &viewports)
+{
+  // Resized rather than rebuilt, so the point buffers are kept between frames.
+  viewports.resize (layout == LAYOUT_SINGLE ? 1 : 2);
+
+  switch (layout)
+    {
+    case LAYOUT_SINGLE:
+    case LAYOUT_COUNT:
+      set_viewport (viewports[0], camera, 0, 0, WW, WH);
+      break;
+
+    case LAYOUT_SPLIT:
+      {
+        Camera behind = camera;
+
+        behind.y += PI;
+        behind.p = -camera.p;
+
+        set_viewport (viewports[0], camera, 0, 0, WW / 2.0f, WH);
+        set_viewport (viewports[1], behind, WW / 2.0f, 0, WW / 2.0f, WH);
+      }
+      break;
+
+    case LAYOUT_STEREO:
+      {
+        // Horizontal, to the camera's right, as D moves it.
+        const auto half = baseline / 2.0;
+
+        const t::vector3su right (half * std::cos (camera.y + PI_2),
+                                  half * std::sin (camera.y + PI_2), t::spatial_unit (0));
+
+        Camera left_eye = camera, right_eye = camera;
+
+        left_eye.position -= right;
+        right_eye.position += right;
+
+        set_viewport (viewports[0], left_eye, 0, 0, WW / 2.0f, WH);
+        set_viewport (viewports[1], right_eye, WW / 2.0f, 0, WW / 2.0f, WH);
+      }
+      break;
+
+    case LAYOUT_MINIMAP:
+      {
+        Camera down = camera;
+
+        down.p = -PI_2;
+        down.focal_length = camera.focal_length / 2;
+
+        const float width = WW * INSET_SCALE, height = WH * INSET_SCALE;
+
+        set_viewport (viewports[0], camera, 0, 0, WW, WH);
+        set_viewport (viewports[1], down, WW - width - INSET_MARGIN, INSET_MARGIN, width, height,
+                      true);
+      }
+      break;
+    }
+}
+
+const Viewport *
+viewport_at (const std::vector<Viewport> &viewports, float x, float y)
+{
+  // Later viewports are drawn over earlier ones.
+  for (auto it = viewports.rbegin (); it != viewports.rend (); ++it)
+    if (x >= it->left && y >= it->top && x < it->left + it->width && y < it->top + it->height)
+      return &*it;
+
+  return nullptr;
+}
+
+void
+Multi_View::render (const Catalog &catalog, const Body_Index &index, const t::vector3su &origin,
+                    const Exposure &exposure, double flux_cutoff, size_t star_budget,
+                    Intensity_Histogram *histogram)
+{
+  uint64_t culled = 0;
+
+  for (size_t v = 0; v < viewports.size (); ++v)
+    {
+      const Camera &camera = viewports[v].camera;
+      const Projection projection (camera, viewports[v].width, viewports[v].height);
+
+      index.visible (camera.position,
+                     projection.unproject (projection.half_width, projection.half_height),
+                     projection.half_angle (), flux_cutoff, v == 0 ? ranges : cone,
+                     v == 0 && histogram ? &culled : nullptr);
+
+      if (v > 0)
+        ranges.insert (ranges.end (), cone.begin (), cone.end ());
+    }
+
+  // Ranges of different cones are the same, nested or disjoint nodes; catalog order keeps the
+  // faint buckets first for limit_ranges().
+  if (viewports.size () > 1)
+    {
+      std::sort (ranges.begin (), ranges.end (),
+                 [] (const auto &a, const auto &b) { return a.begin < b.begin; });
+
+      size_t kept = 0;
+
+      for (size_t r = 1; r < ranges.size (); ++r)
+        {
+          if (ranges[r].begin <= ranges[kept].end)
+            ranges[kept].end = std::max (ranges[kept].end, ranges[r].end);
+          else
+            ranges[++kept] = ranges[r];
+        }
+
+      ranges.resize (ranges.empty () ? 0 : kept + 1);
+    }
+
+  // Stars over the budget are the faintest buckets, so like culled ones they meter as dark.
+  const size_t dropped = limit_ranges (ranges, star_budget);
+
+  visible = dropped;
+
+  for (const auto &range : ranges)
+    visible += range.end - range.begin;
+
+  if (histogram)
+    culled += dropped;
+
+  shade (catalog, origin, exposure, culled, histogram);
+}
+
+void
+Multi_View::shade (const Catalog &catalog, const t::vector3su &origin, const Exposure &exposure,
+                   uint64_t culled, Intensity_Histogram *histogram)
+{
+  offsets.resize (ranges.size () + 1);
+  offsets[0] = 0;
+
+  for (size_t r = 0; r < ranges.size (); ++r)
+    offsets[r + 1] = offsets[r] + ranges[r].end - ranges[r].begin;
+
+  shaded = offsets.back ();
+
+  // Only needed to hand the shared results to further viewports.
+  const bool shared = viewports.size () > 1;
+
+  if (shared)
+    {
+      colors.resize (shaded);
+      relative.resize (3 * shaded);
+    }
+
+  for (auto &viewport : viewports)
+    if (viewport.points.size () < shaded)
+      viewport.points.resize (shaded);
+
+  // Every thread meters into its own copy, summed by the reduction; culled stars are all fainter
+  // than anything shaded, so they go straight into the bottom bin.
+  uint64_t bins[Intensity_Histogram::BINS] = {};
+
+  bins[0] = culled;
+
+  const bool metering = histogram != nullptr;
+
+  const double AU = t::spatial_unit::AU;
+
+  const Placement first (viewports[0], origin);
+
+  const bool sprites = psf_enabled && !exposure.seeall;
+
+  if (sprites)
+    psf.update (viewports[0].camera);
+
+  bright.resize (omp_get_max_threads ());
+
+  for (auto &list : bright)
+    list.clear ();
+
+  sf::Vertex *const first_points = viewports[0].points.data ();
+  sf::Color *const shared_colors = colors.data ();
+  float *const shared_relative = relative.data ();
+
+  // Shading is fused with the first viewport's projection, so a single view costs one pass.
+#pragma omp parallel for schedule(dynamic) firstprivate(first) \
+    reduction(+ : bins[:Intensity_Histogram::BINS])
+  for (size_t r = 0; r < ranges.size (); ++r)
+    {
+      size_t k = offsets[r];
+
+      for (uint32_t i = ranges[r].begin; i < ranges[r].end; ++i, ++k)
+        {
+          const Body &body = catalog.bodies[i];
+
+          const double x = (body.position.x - origin.x).as_Mm ();
+          const double y = (body.position.y - origin.y).as_Mm ();
+          const double z = (body.position.z - origin.z).as_Mm ();
+
+          const double D2 = (x * x + y * y + z * z) / (AU * AU);
+          const double I = exposure.intensity (body.luminosity, D2);
+
+          Star_Sample sample;
+
+          shade_color (exposure, catalog.colors[i], I, sample);
+
+          const sf::Color color (sample.r, sample.g, sample.b, std::min (255.0 * I, 255.0));
+
+          if (shared)
+            {
+              shared_colors[k] = color;
+              shared_relative[3 * k + 0] = x;
+              shared_relative[3 * k + 1] = y;
+              shared_relative[3 * k + 2] = z;
+            }
+
+          // Metered as the single-view renderer does: anything in front of the camera.
+          if (first.place (x, y, z, color, first_points[k]) && metering)
+            bins[Intensity_Histogram::bin (std::min (I, 1e30))]++;
+
+          if (sprites && I >= Psf_Atlas::THRESHOLD)
+            bright[omp_get_thread_num ()].push_back ({ k, I, catalog.colors[i] });
+        }
+    }
+
+  // Further viewports reuse the offsets and colours, so they only rotate and divide.
+  for (size_t v = 1; v < viewports.size (); ++v)
+    {
+      const Placement placement (viewports[v], origin);
+
+      sf::Vertex *const points = viewports[v].points.data ();
+
+#pragma omp parallel for schedule(static) firstprivate(placement)
+      for (size_t k = 0; k < shaded; ++k)
+        placement.place (shared_relative[3 * k + 0], shared_relative[3 * k + 1],
+                         shared_relative[3 * k + 2], shared_colors[k], points[k]);
+    }
+
+  // Few enough to be done serially. A sprite takes the place of its star's point in every
+  // viewport the point landed in; it may spill a few pixels over the edge of an inset.
+  bright_count = 0;
+
+  for (auto &viewport : viewports)
+    {
+      viewport.sprites.clear ();
+
+      for (const auto &list : bright)
+        for (const Bright_Star &star : list)
+          {
+            sf::Vertex &point = viewport.points[star.k];
+
+            if (point.color.a == 0)
+              continue;
+
+            const float *c = exposure.palette.rgb[star.color];
+            const auto channel = [&] (float linear) {
+              return exposure.srgb[static_cast<int> (linear * (SRGB_TABLE_SIZE - 1))];
+            };
+
+            psf.emit (point.position.x, point.position.y, star.intensity,
+                      sf::Color (channel (c[0]), channel (c[1]), channel (c[2])),
+                      viewport.sprites);
+
+            point.color.a = 0;
+          }
+
+      bright_count += viewport.sprites.size () / 6;
+    }
+
+  if (histogram)
+    std::copy (bins, bins + Intensity_Histogram::BINS, histogram->bins);
+}
+
+void
+Multi_View::draw (sf::RenderTarget &target) const
+{
+  for (const auto &viewport : viewports)
+    {
+      if (viewport.inset)
+        {
+          sf::RectangleShape backdrop ({ viewport.width, viewport.height });
+
+          backdrop.setPosition (viewport.left, viewport.top);
+          backdrop.setFillColor (sf::Color{ 12, 12, 12 });
+          backdrop.setOutlineThickness (1);
+          backdrop.setOutlineColor (sf::Color{ 128, 128, 128 });
+
+          target.draw (backdrop);
+        }
+
+      if (shaded > 0)
+        target.draw (viewport.points.data (), shaded, sf::Points, sf::BlendMode (sf::BlendAdd));
+
+      if (!viewport.sprites.empty ())
+        {
+          sf::RenderStates states (sf::BlendMode (sf::BlendMode::One, sf::BlendMode::One));
+
+          states.texture = &psf.texture;
+
+          target.draw (viewport.sprites.data (), viewport.sprites.size (), sf::Triangles, states);
+        }
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef VIEWS_HPP
+#define VIEWS_HPP
+
+#include <SFML/Graphics.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "camera.hpp"
+#include "catalog.hpp"
+#include "index.hpp"
+#include "metering.hpp"
+#include "psf.hpp"
+#include "render.hpp"
+
+enum View_Layout
+{
+  // The camera alone, filling the window.
+  LAYOUT_SINGLE,
+
+  // Looking ahead on the left half and behind on the right.
+  LAYOUT_SPLIT,
+
+  // Left and right eye side by side for parallel viewing, `baseline` apart.
+  LAYOUT_STEREO,
+
+  // The camera with a wide-angle inset looking straight down in the top right corner.
+  LAYOUT_MINIMAP,
+
+  LAYOUT_COUNT
+};
+
+// A camera drawn into a rectangle of the window.
+struct Viewport
+{
+  Camera camera;
+  float left, top, width, height;
+
+  // Drawn over another viewport, so it gets a backdrop and a frame of its own.
+  bool inset{ false };
+
+  // One point per shaded star, in the shared pass's order; stars that land outside the rectangle
+  // or behind the camera keep zero alpha.
+  std::vector<sf::Vertex> points;
+
+  // Point-spread sprites of the bright stars, whose points are then left out.
+  std::vector<sf::Vertex> sprites;
+};
+
+// Viewports for `camera` in a layout; stereo eyes are `baseline` apart.
+void layout_viewports (View_Layout layout, const Camera &camera, t::spatial_unit baseline,
+                       std::vector<Viewport> &viewports);
+
+// The viewport drawn at window pixel (x, y), insets over what they cover; null if there is none.
+const Viewport *viewport_at (const std::vector<Viewport> &viewports, float x, float y);
+
+// Renders several viewports from one culling and shading pass. The index is walked once for the
+// union of their view cones, and every star's distance, intensity and colour is worked out once,
+// from `origin` with one exposure; each viewport then only projects. Viewports are expected to sit
+// close to `origin` compared with the stars they show, as stereo eyes and an inset at the camera
+// do.
+struct Multi_View
+{
+  std::vector<Viewport> viewports;
+
+  // Union of the viewports' visible ranges, in catalog order, and where each range's stars start
+  // in the shared arrays.
+  std::vector<Body_Index::Range> ranges;
+  std::vector<Body_Index::Range> cone;
+  std::vector<size_t> offsets;
+
+  // Shared results per star when there is more than one viewport: colour, and offset from the
+  // origin in Mm (x, y, z).
+  std::vector<sf::Color> colors;
+  std::vector<float> relative;
+
+  // Stars shaded by the last render(), and those it found in view before `star_budget`.
+  size_t shaded{ 0 };
+  size_t visible{ 0 };
+
+  // Bright stars are drawn with point-spread sprites for the first viewport's lens when enabled.
+  // Each thread of the shading pass collects the ones it finds.
+  struct Bright_Star
+  {
+    size_t k;
+    double intensity;
+    uint8_t color;
+  };
+
+  bool psf_enabled{ true };
+  Psf_Atlas psf;
+  std::vector<std::vector<Bright_Star>> bright;
+  size_t bright_count{ 0 };
+
+  // `histogram`, when given, is refilled from the shared pass: culled stars of the first viewport
+  // and stars left out for `star_budget` go in the bottom bin, as in the single-view renderer.
+  void render (const Catalog &catalog, const Body_Index &index, const t::vector3su &origin,
+               const Exposure &exposure, double flux_cutoff, size_t star_budget,
+               Intensity_Histogram *histogram);
+
+  // The second half of render(): shades and projects the stars of `ranges` as they are. `culled`
+  // stars are added to the bottom bin of `histogram`.
+  void shade (const Catalog &catalog, const t::vector3su &origin, const Exposure &exposure,
+              uint64_t culled, Intensity_Histogram *histogram);
+
+  void draw (sf::RenderTarget &target) const;
+};
+
+#endif // VIEWS_HPP
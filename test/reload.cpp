@@ -0,0 +1,138 @@
+// Checks for incremental catalog reloads:
+//
+//   make check && ./check.out
+//
+// Writes small CSV catalogs to a temporary directory, reloads them against each other with
+// reload_gaia() and compares the reported Reload_Stats with what actually changed. Prints every
+// failed check and exits non-zero if there was one.
+
+#include "catalog.hpp"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+int failures = 0;
+
+void
+expect (bool ok, const char *what, int line)
+{
+  if (!ok)
+    {
+      std::printf ("FAIL: line %d: %s\n", line, what);
+      failures++;
+    }
+}
+
+#define EXPECT(condition) expect ((condition), #condition, __LINE__)
+
+struct Row
+{
+  int64_t source_id;
+  double parallax;
+};
+
+void
+write_csv (const std::string &path, const std::vector<Row> &rows)
+{
+  std::ofstream file (path);
+
+  file << "source_id,ra,dec,parallax,lum_flame,pmra,pmdec,radial_velocity,bp_rp,teff_gspphot\n";
+
+  for (const Row &row : rows)
+    file << row.source_id << ",10.5,-20.25," << row.parallax << ",1.5,3.0,-4.0,12.0,0.8,5800\n";
+}
+
+bool
+same (const Reload_Stats &stats, size_t unchanged, size_t changed, size_t added, size_t removed)
+{
+  return stats.unchanged == unchanged && stats.changed == changed && stats.added == added
+         && stats.removed == removed;
+}
+
+// Two files sharing some source_ids, the second overriding the first, as with several --catalog
+// paths. Every shared row is stored twice by a load, but must be counted once.
+void
+test_cross_file_duplicates (const std::string &directory)
+{
+  const std::string a = directory + "/a.csv", b = directory + "/b.csv";
+  const std::vector<std::string> paths{ a, b };
+
+  std::vector<Row> rows_a, rows_b;
+
+  for (int64_t id = 1; id <= 1000; ++id)
+    rows_a.push_back ({ id, 2.0 });
+
+  for (int64_t id = 501; id <= 1500; ++id)
+    rows_b.push_back ({ id, 4.0 });
+
+  write_csv (a, rows_a);
+  write_csv (b, rows_b);
+
+  Catalog empty, first;
+  Reload_Stats stats;
+
+  EXPECT (reload_gaia (paths, empty, first, stats));
+  EXPECT (first.size () == 1500);
+  EXPECT (same (stats, 0, 0, 1500, 0));
+
+  // Nothing written since: nothing changed.
+  Catalog second;
+
+  EXPECT (reload_gaia (paths, first, second, stats));
+  EXPECT (second.size () == 1500);
+  EXPECT (same (stats, 1500, 0, 0, 0));
+
+  // A shared row changed in the first file only is still overridden by the second.
+  rows_a[600].parallax = 3.0;
+  write_csv (a, rows_a);
+
+  Catalog third;
+
+  EXPECT (reload_gaia (paths, second, third, stats));
+  EXPECT (same (stats, 1500, 0, 0, 0));
+
+  // One row changed where it wins, one dropped and two added.
+  rows_b[0].parallax = 5.0;
+  rows_b.pop_back ();
+  rows_b.push_back ({ 2000, 1.0 });
+  rows_b.push_back ({ 2001, 1.0 });
+  write_csv (b, rows_b);
+
+  Catalog fourth;
+
+  EXPECT (reload_gaia (paths, third, fourth, stats));
+  EXPECT (fourth.size () == 1501);
+  EXPECT (same (stats, 1498, 1, 2, 1));
+
+  std::remove (a.c_str ());
+  std::remove (b.c_str ());
+}
+} // namespace
+
+int
+main ()
+{
+  char directory[] = "/tmp/unexp-check-XXXXXX";
+
+  if (!mkdtemp (directory))
+    {
+      std::printf ("FAIL: cannot create a temporary directory\n");
+      return 1;
+    }
+
+  test_cross_file_duplicates (directory);
+
+  rmdir (directory);
+
+  if (failures == 0)
+    std::printf ("all checks passed\n");
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,281 @@
+#!/usr/bin/python3
+
+# Builds res/ephemeris.bin: Chebyshev coefficient tables for the planets and the Moon, fitted to
+# JPL's approximate Keplerian elements (Standish, table 1, valid 1800-2050) and a truncated lunar
+# theory. Positions are in AU, J2000 ecliptic; planets are heliocentric, the Moon is geocentric.
+
+import math
+import struct
+
+OUTPUT_PATH = "res/ephemeris.bin"
+
+J2000 = 2451545.0
+
+JD_START = 2433282.5  # 1950-01-01
+JD_END = 2469807.5  # 2050-01-01
+
+EMRAT = 81.30056
+
+# name: (a, e, I, L, long.peri, long.node), rates per Julian century
+ELEMENTS = {
+    "Mercury": (
+        (0.38709927, 0.20563593, 7.00497902, 252.25032350, 77.45779628, 48.33076593),
+        (0.00000037, 0.00001906, -0.00594749, 149472.67411175, 0.16047689, -0.12534081),
+    ),
+    "Venus": (
+        (0.72333566, 0.00677672, 3.39467605, 181.97909950, 131.60246718, 76.67984255),
+        (0.00000390, -0.00004107, -0.00078890, 58517.81538729, 0.00268329, -0.27769418),
+    ),
+    "EMB": (
+        (1.00000261, 0.01671123, -0.00001531, 100.46457166, 102.93768193, 0.0),
+        (0.00000562, -0.00004392, -0.01294668, 35999.37244981, 0.32327364, 0.0),
+    ),
+    "Mars": (
+        (1.52371034, 0.09339410, 1.84969142, -4.55343205, -23.94362959, 49.55953891),
+        (0.00001847, 0.00007882, -0.00813131, 19140.30268499, 0.44441088, -0.29257343),
+    ),
+    "Jupiter": (
+        (5.20288700, 0.04838624, 1.30439695, 34.39644051, 14.72847983, 100.47390909),
+        (-0.00011607, -0.00013253, -0.00183714, 3034.74612775, 0.21252668, 0.20469106),
+    ),
+    "Saturn": (
+        (9.53667594, 0.05386179, 2.48599187, 49.95424423, 92.59887831, 113.66242448),
+        (-0.00125060, -0.00050991, 0.00193609, 1222.49362201, -0.41897216, -0.28867794),
+    ),
+    "Uranus": (
+        (19.18916464, 0.04725744, 0.77263783, 313.23810451, 170.95427630, 74.01692503),
+        (-0.00196176, -0.00004397, -0.00242939, 428.48202785, 0.40805281, 0.04240589),
+    ),
+    "Neptune": (
+        (30.06992276, 0.00859048, 1.77004347, -55.12002969, 44.96476227, 131.78422574),
+        (0.00026291, 0.00005105, 0.00035372, 218.45945325, -0.32241464, -0.00508664),
+    ),
+    "Pluto": (
+        (39.48211675, 0.24882730, 17.14001206, 238.92903833, 224.06891629, 110.30393684),
+        (-0.00031596, 0.00005170, 0.00004818, 145.20780515, -0.04062942, -0.01183482),
+    ),
+}
+
+MOON_ELEMENTS = (384400.0 / 149597870.7, 0.0549, 5.145, 125.1228, 318.0634)
+
+
+def rotate(xp, yp, i, node, peri):
+    ci, si = math.cos(i), math.sin(i)
+    cn, sn = math.cos(node), math.sin(node)
+    cw, sw = math.cos(peri), math.sin(peri)
+
+    x = (cw * cn - sw * sn * ci) * xp + (-sw * cn - cw * sn * ci) * yp
+    y = (cw * sn + sw * cn * ci) * xp + (-sw * sn + cw * cn * ci) * yp
+    z = (sw * si) * xp + (cw * si) * yp
+
+    return x, y, z
+
+
+def kepler(M, e):
+    E = M + e * math.sin(M)
+
+    for _ in range(32):
+        dE = (E - e * math.sin(E) - M) / (1 - e * math.cos(E))
+        E -= dE
+
+        if abs(dE) < 1e-15:
+            break
+
+    return E
+
+
+def planet(name, jd):
+    base, rate = ELEMENTS[name]
+    T = (jd - J2000) / 36525.0
+
+    a, e, I, L, varpi, node = (b + r * T for b, r in zip(base, rate))
+
+    peri = varpi - node
+    M = math.radians(math.remainder(L - varpi, 360.0))
+    E = kepler(M, e)
+
+    xp = a * (math.cos(E) - e)
+    yp = a * math.sqrt(1 - e * e) * math.sin(E)
+
+    return rotate(xp, yp, math.radians(I), math.radians(node), math.radians(peri))
+
+
+def moon(jd):
+    d = jd - 2451543.5
+
+    N = math.radians(125.1228 - 0.0529538083 * d)
+    i = math.radians(5.1454)
+    w = math.radians(318.0634 + 0.1643573223 * d)
+    e = 0.054900
+    Mm = math.radians(115.3654 + 13.0649929509 * d)
+
+    E = kepler(math.remainder(Mm, math.tau), e)
+
+    xp = 60.2666 * (math.cos(E) - e)
+    yp = 60.2666 * math.sqrt(1 - e * e) * math.sin(E)
+
+    r = math.hypot(xp, yp)
+    v = math.atan2(yp, xp)
+
+    x, y, z = rotate(r * math.cos(v), r * math.sin(v), i, N, w)
+
+    lon = math.atan2(y, x)
+    lat = math.atan2(z, math.hypot(x, y))
+
+    Ms = math.radians(356.0470 + 0.9856002585 * d)
+    ws = math.radians(282.9404 + 4.70935e-5 * d)
+
+    Ls = Ms + ws
+    Lm = Mm + w + N
+    D = Lm - Ls
+    F = Lm - N
+
+    lon += math.radians(
+        -1.274 * math.sin(Mm - 2 * D)
+        + 0.658 * math.sin(2 * D)
+        - 0.186 * math.sin(Ms)
+        - 0.059 * math.sin(2 * Mm - 2 * D)
+        - 0.057 * math.sin(Mm - 2 * D + Ms)
+        + 0.053 * math.sin(Mm + 2 * D)
+        + 0.046 * math.sin(2 * D - Ms)
+        + 0.041 * math.sin(Mm - Ms)
+        - 0.035 * math.sin(D)
+        - 0.031 * math.sin(Mm + Ms)
+        - 0.015 * math.sin(2 * F - 2 * D)
+        + 0.011 * math.sin(Mm - 4 * D)
+    )
+
+    lat += math.radians(
+        -0.173 * math.sin(F - 2 * D)
+        - 0.055 * math.sin(Mm - F - 2 * D)
+        - 0.046 * math.sin(Mm + F - 2 * D)
+        + 0.033 * math.sin(F + 2 * D)
+        + 0.017 * math.sin(2 * Mm + F)
+    )
+
+    r += -0.58 * math.cos(Mm - 2 * D) - 0.46 * math.cos(2 * D)
+
+    # Ecliptic of date to J2000.
+    lon -= math.radians(3.82394e-5 * (jd - J2000))
+
+    r *= 6378.14 / 149597870.7
+
+    return (
+        r * math.cos(lat) * math.cos(lon),
+        r * math.cos(lat) * math.sin(lon),
+        r * math.sin(lat),
+    )
+
+
+def earth(jd):
+    b = planet("EMB", jd)
+    m = moon(jd)
+
+    return tuple(bi - mi / (1 + EMRAT) for bi, mi in zip(b, m))
+
+
+def chebyshev_fit(f, t0, length, degree):
+    n = degree + 1
+    nodes = [math.cos(math.pi * (k + 0.5) / n) for k in range(n)]
+    samples = [f(t0 + (x + 1) * 0.5 * length) for x in nodes]
+
+    coeffs = []
+
+    for axis in range(3):
+        c = []
+
+        for j in range(n):
+            s = sum(
+                samples[k][axis] * math.cos(math.pi * j * (k + 0.5) / n) for k in range(n)
+            )
+            c.append(s * 2.0 / n)
+
+        c[0] *= 0.5
+        coeffs.append(c)
+
+    return coeffs
+
+
+def chebyshev_eval(c, x):
+    b0 = b1 = 0.0
+
+    for ck in reversed(c[1:]):
+        b0, b1 = 2 * x * b0 - b1 + ck, b0
+
+    return x * b0 - b1 + c[0]
+
+
+# name, center, function, interval in days, degree, orbital elements
+BODIES = [
+    ("Mercury", -1, lambda jd: planet("Mercury", jd), 24.0, 13),
+    ("Venus", -1, lambda jd: planet("Venus", jd), 64.0, 11),
+    ("Earth", -1, earth, 32.0, 13),
+    ("Mars", -1, lambda jd: planet("Mars", jd), 128.0, 11),
+    ("Jupiter", -1, lambda jd: planet("Jupiter", jd), 512.0, 11),
+    ("Saturn", -1, lambda jd: planet("Saturn", jd), 1024.0, 11),
+    ("Uranus", -1, lambda jd: planet("Uranus", jd), 2048.0, 11),
+    ("Neptune", -1, lambda jd: planet("Neptune", jd), 2048.0, 11),
+    ("Pluto", -1, lambda jd: planet("Pluto", jd), 2048.0, 11),
+    ("Moon", 2, moon, 16.0, 13),
+]
+
+
+def elements(name):
+    if name == "Moon":
+        return MOON_ELEMENTS
+
+    (a, e, I, L, varpi, node), _ = ELEMENTS["EMB" if name == "Earth" else name]
+
+    return (a, e, I, node, varpi - node)
+
+
+def main():
+    header = struct.pack("<4sIIIdd", b"TEPH", 1, len(BODIES), 0, JD_START, JD_END)
+
+    records = b""
+    blob = []
+
+    for name, center, f, interval, degree in BODIES:
+        count = math.ceil((JD_END - JD_START) / interval)
+        offset = len(blob)
+        error = 0.0
+
+        for k in range(count):
+            t0 = JD_START + k * interval
+            coeffs = chebyshev_fit(f, t0, interval, degree)
+
+            for c in coeffs:
+                blob.extend(c)
+
+            # Measured as stored, rounded to float32, which dominates the fit error far out.
+            stored = [struct.unpack(f"<{len(c)}f", struct.pack(f"<{len(c)}f", *c)) for c in coeffs]
+
+            for x in (-0.9, -0.3, 0.4, 0.95):
+                exact = f(t0 + (x + 1) * 0.5 * interval)
+
+                for axis in range(3):
+                    error = max(error, abs(chebyshev_eval(stored[axis], x) - exact[axis]))
+
+        records += struct.pack(
+            "<16siIIIdQ5d",
+            name.encode(),
+            center,
+            degree,
+            count,
+            0,
+            interval,
+            offset,
+            *elements(name),
+        )
+
+        print(f"{name:8} {count:5} intervals, max fit error {error * 149597870.7:10.3f} km")
+
+    with open(OUTPUT_PATH, "wb") as file:
+        file.write(header)
+        file.write(records)
+        file.write(struct.pack(f"<{len(blob)}f", *blob))
+
+    print(f"{OUTPUT_PATH}: {len(blob)} coefficient(s) written")
+
+
+main()
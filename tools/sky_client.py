@@ -0,0 +1,138 @@
+#!/usr/bin/python3
+
+# Sends sky-image requests to a running `a.out serve SOCKET` and saves the answers. Requests are
+# read one per line from stdin (or FILE), in the service's format:
+#
+#   x_pc y_pc z_pc yaw_deg pitch_deg focal_length_mm f t iso [WxH] [png | ppm]
+#
+# and spread over JOBS connections at once, so the service batches them. Images are written to
+# OUTDIR as image_NNNNNN.png (or .ppm), numbered by request line; per-request latency and the
+# overall throughput are printed.
+#
+#   tools/sky_client.py /tmp/sky.sock -j 4 -o thumbs < requests.txt
+
+import argparse
+import os
+import socket
+import sys
+import threading
+import time
+
+
+def read_line(stream):
+    line = bytearray()
+
+    while not line.endswith(b"\n"):
+        byte = stream.read(1)
+
+        if not byte:
+            raise ConnectionError("service closed the connection")
+
+        line += byte
+
+    return line.decode().strip()
+
+
+def read_exact(stream, size):
+    data = stream.read(size)
+
+    if len(data) != size:
+        raise ConnectionError("service closed the connection")
+
+    return data
+
+
+def worker(path, jobs, outdir, results):
+    # Pipelines every request of this worker on one connection, then reads the answers in order.
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as connection:
+        connection.connect(path)
+
+        start = time.perf_counter()
+
+        connection.sendall("".join(request + "\n" for _, request in jobs).encode())
+        connection.shutdown(socket.SHUT_WR)
+
+        stream = connection.makefile("rb")
+
+        for number, request in jobs:
+            header = read_line(stream).split(" ", 1)
+
+            if header[0] != "OK":
+                results[number] = (None, header[1] if len(header) > 1 else "error")
+                continue
+
+            size, latency_ms, render_ms = header[1].split()
+
+            image = read_exact(stream, int(size))
+
+            extension = "ppm" if "ppm" in request.split()[9:] else "png"
+
+            with open(os.path.join(outdir, "image_%06d.%s" % (number, extension)), "wb") as file:
+                file.write(image)
+
+            results[number] = (
+                (float(latency_ms), float(render_ms), (time.perf_counter() - start) * 1e3),
+                None,
+            )
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Request sky images from `a.out serve`.")
+    parser.add_argument("socket")
+    parser.add_argument("file", nargs="?", help="request lines (stdin by default)")
+    parser.add_argument("-j", "--jobs", type=int, default=1, help="concurrent connections")
+    parser.add_argument("-o", "--outdir", default=".")
+    args = parser.parse_args()
+
+    with open(args.file) if args.file else sys.stdin as source:
+        requests = [line.strip() for line in source]
+
+    requests = [r for r in requests if r and not r.startswith("#")]
+
+    os.makedirs(args.outdir, exist_ok=True)
+
+    jobs = max(1, min(args.jobs, len(requests)))
+    results = [None] * len(requests)
+
+    threads = [
+        threading.Thread(
+            target=worker,
+            args=(args.socket, list(enumerate(requests))[j::jobs], args.outdir, results),
+        )
+        for j in range(jobs)
+    ]
+
+    start = time.perf_counter()
+
+    for thread in threads:
+        thread.start()
+
+    for thread in threads:
+        thread.join()
+
+    seconds = time.perf_counter() - start
+
+    failed = 0
+
+    for number, result in enumerate(results):
+        if result is None or result[0] is None:
+            failed += 1
+            error = result[1] if result else "no answer"
+            print("#%d: ERROR %s" % (number, error))
+        else:
+            latency_ms, render_ms, client_ms = result[0]
+            print(
+                "#%d: %.2f ms in the service (render %.2f ms), %.2f ms at the client"
+                % (number, latency_ms, render_ms, client_ms)
+            )
+
+    print(
+        "%d image(s) in %.2fs, %.2f images/s over %d connection(s)"
+        % (len(requests) - failed, seconds, (len(requests) - failed) / seconds, jobs)
+    )
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())